@@ -0,0 +1,78 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "Command.hpp"
+#include "Protocol.hpp"
+
+/*
+  Compares the JSON framing of a Command with the binary protocol.
+  For every sample command it measures the payload size and the time
+  needed to serialize and parse it back.
+  Build with "make protocol_bench".
+*/
+
+struct Sample {
+  std::string name;
+  Command command;
+};
+
+template <typename F>
+double ns_per_op(F&& f, size_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+  size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+  std::string deck;
+  for (int i = 0; i < 15; i++) {
+    deck += "4 Card Number " + std::to_string(i) + "\r\n";
+  }
+  deck += "\r\n15 Sideboard Card\r\n";
+  std::vector<Sample> samples = {
+    {"Pass Priority", Command(CommandCode::PassPriority)},
+    {"Play Card", Command(CommandCode::PlayCard, "42", "battlefield")},
+    {"Upload Deck", Command(CommandCode::UploadDeck, deck)},
+  };
+  volatile size_t sink = 0;
+  std::cout << std::left << std::setw(16) << "command"
+            << std::setw(12) << "json bytes" << std::setw(12) << "bin bytes"
+            << std::setw(14) << "json ser ns" << std::setw(14) << "bin ser ns"
+            << std::setw(14) << "json parse ns" << std::setw(14) << "bin parse ns" << "\n";
+  for (auto& sample : samples) {
+    std::string json_payload = encode_command_json(sample.command);
+    std::string bin_payload;
+    encode_command(sample.command, bin_payload);
+
+    double json_ser = ns_per_op([&]() {
+      sink = sink + encode_command_json(sample.command).size();
+    }, iterations);
+    double bin_ser = ns_per_op([&]() {
+      std::string out;
+      encode_command(sample.command, out);
+      sink = sink + out.size();
+    }, iterations);
+    Command decoded;
+    double json_parse = ns_per_op([&]() {
+      decode_command(json_payload.data(), json_payload.size(), decoded);
+      sink = sink + decoded.target.size();
+    }, iterations);
+    double bin_parse = ns_per_op([&]() {
+      decode_command(bin_payload.data(), bin_payload.size(), decoded);
+      sink = sink + decoded.target.size();
+    }, iterations);
+
+    std::cout << std::left << std::setw(16) << sample.name
+              << std::setw(12) << json_payload.size() << std::setw(12) << bin_payload.size()
+              << std::fixed << std::setprecision(1)
+              << std::setw(14) << json_ser << std::setw(14) << bin_ser
+              << std::setw(14) << json_parse << std::setw(14) << bin_parse << "\n";
+  }
+  return sink == 0;
+}
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "Scryfall.hpp"
+
+/*
+  Resolves the cards of a decklist through the Scryfall API the way the
+  client does when it shows a deck: one prefetchCardRecords for the whole
+  list, then getCardRecord card by card, and prints how long it took and
+  the names left unresolved. Set PSIM_LOG=scryfall=debug to see every
+  request, the batches and the 429 retries.
+  Cards already in data/json are not asked again: run it from an empty
+  directory to measure a cold load. bench/scryfall_standin.py stands in
+  for the API so that nothing is sent to api.scryfall.com:
+
+    python3 bench/scryfall_standin.py 8080 &
+    ./scryfall_bench --url http://127.0.0.1:8080 deck.txt
+
+  Build with "make scryfall_bench".
+  Usage: ./scryfall_bench [--url URL] DECK
+*/
+
+int main(int argc, char* argv[]) {
+  std::string url;
+  std::string deck;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--url" && i + 1 < argc) url = argv[++i];
+    else deck = arg;
+  }
+  std::ifstream is(deck);
+  if (deck.empty() || !is) {
+    std::cerr << "Usage: ./scryfall_bench [--url URL] DECK\n";
+    return 1;
+  }
+  // Decklist lines are "<copies> <name>", the sideboard follows an empty line.
+  std::vector<std::string> names;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    size_t space = line.find(' ');
+    if (space == std::string::npos || line == "Sideboard") continue;
+    names.push_back(line.substr(space + 1));
+  }
+
+  ScryfallAPI api;
+  if (!url.empty()) api.setBaseUrl(url);
+  auto begin = std::chrono::steady_clock::now();
+  api.prefetchCardRecords(names);
+  double prefetch = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  size_t resolved = 0;
+  for (const std::string& name : names) {
+    if (api.getCardRecord(name).valid) resolved++;
+    else std::cout << "unresolved: " << name << "\n";
+  }
+  double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  std::cout << resolved << "/" << names.size() << " cards resolved in " << std::fixed << std::setprecision(3)
+            << total << " s (" << prefetch << " s in the batched prefetch)\n";
+  return resolved == names.size() ? 0 : 2;
+}
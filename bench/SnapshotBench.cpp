@@ -0,0 +1,75 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "Game.hpp"
+
+/*
+  Cost of undoing a partial action on game states of growing size:
+  a journaled snapshot, a few changes and a rollback, against a deep
+  copy of the state taken before the changes and assigned back.
+  The journal only depends on the number of changes, the copy grows
+  with the number of objects in the game.
+  Build with "make snapshot_bench".
+*/
+
+#define SNAPSHOT_BENCH_CHANGES 16
+
+template <typename F>
+double ns_per_op(F&& f, size_t iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+void build(Game& game, size_t objects) {
+  // Spread over the zones of both players, like a long game.
+  static const Zone zones[] = {Zone::Library, Zone::Library, Zone::Hand, Zone::Battlefield, Zone::Graveyard};
+  CardDefinitionId bear = CardDefinitions::instance().intern("Grizzly Bears", "", "Creature — Bear", 2);
+  game.zones.reserve(objects);
+  for (size_t i = 0; i < objects; i++) {
+    game.zones.create(ObjectKind::Card, bear, static_cast<uint8_t>(i % 2), zones[i % 5]);
+  }
+}
+
+void play(Game& game) {
+  // A partial action: draw, cast, pay, target; SNAPSHOT_BENCH_CHANGES changes.
+  for (int i = 0; i < SNAPSHOT_BENCH_CHANGES / 4; i++) {
+    ZoneStore::Instance card = game.zones.top(0, Zone::Library);
+    game.zones.move(card, Zone::Hand);
+    game.zones.move(card, Zone::Stack);
+    game.zones.set_tapped(game.zones.top(0, Zone::Battlefield), true);
+    game.set_life(1, game.info.life_points.second - 1);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  size_t iterations = argc > 1 ? std::stoul(argv[1]) : 20000;
+  volatile int sink = 0;
+  std::cout << std::left << std::setw(10) << "objects" << std::setw(16) << "journal ns"
+            << std::setw(16) << "copy ns" << "\n";
+  for (size_t objects : {100, 1000, 10000, 100000}) {
+    Game game;
+    build(game, objects);
+    double journal = ns_per_op([&]() {
+      auto mark = game.snapshot();
+      play(game);
+      sink = sink + game.info.life_points.second;
+      game.rollback(mark);
+    }, iterations);
+    size_t copies = std::max<size_t>(1, iterations * 100 / objects);
+    double copy = ns_per_op([&]() {
+      Game saved = game;
+      play(game);
+      sink = sink + game.info.life_points.second;
+      game = saved;
+    }, copies);
+    std::cout << std::left << std::setw(10) << objects << std::fixed << std::setprecision(1)
+              << std::setw(16) << journal << std::setw(16) << copy << "\n";
+  }
+  return sink == 0;
+}
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""
+Local stand-in for the few Scryfall API endpoints the client uses, to
+exercise ScryfallAPI (common/Scryfall.hpp) without the network:
+  POST /cards/collection  every name is a card, except the ones
+                          starting with "Unknown"
+  GET  /cards/named       ?fuzzy=, same cards
+The first collection request is answered 429 with Retry-After: 1, to
+show the backoff. Every request is printed with the seconds since start
+and the time since the previous one, so the rate limit can be checked.
+
+Usage: python3 bench/scryfall_standin.py [port] [--no-429]
+then point the client at it with PSIM_SCRYFALL_URL=http://127.0.0.1:port
+(or ./scryfall_bench --url).
+"""
+import json
+import sys
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+START = time.monotonic()
+state = {"last": START, "refuse": "--no-429" not in sys.argv}
+
+
+def card(name):
+    return {"object": "card", "name": name, "cmc": 1.0, "type_line": "Instant",
+            "image_uris": {"png": "http://127.0.0.1/images/%s.png" % urllib.parse.quote(name)},
+            "legalities": {"vintage": "legal"}}
+
+
+def known(name):
+    return not name.lower().startswith("unknown")
+
+
+class StandIn(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def trace(self, what):
+        now = time.monotonic()
+        print("%8.3f s (+%4.0f ms) %s" % (now - START, (now - state["last"]) * 1000, what), flush=True)
+        state["last"] = now
+
+    def answer(self, code, body, headers=()):
+        data = json.dumps(body).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        for name, value in headers:
+            self.send_header(name, value)
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        if self.path != "/cards/collection":
+            return self.answer(404, {"object": "error", "code": "not_found"})
+        body = json.loads(self.rfile.read(int(self.headers.get("Content-Length", 0))))
+        identifiers = body.get("identifiers", [])
+        self.trace("POST /cards/collection, %d identifiers" % len(identifiers))
+        if len(identifiers) > 75:
+            return self.answer(422, {"object": "error", "code": "too_many_identifiers"})
+        if state["refuse"]:
+            state["refuse"] = False
+            return self.answer(429, {"object": "error", "code": "rate_limited"}, [("Retry-After", "1")])
+        found = [card(i["name"]) for i in identifiers if known(i.get("name", ""))]
+        missing = [i for i in identifiers if not known(i.get("name", ""))]
+        self.answer(200, {"object": "list", "not_found": missing, "data": found})
+
+    def do_GET(self):
+        url = urllib.parse.urlparse(self.path)
+        name = urllib.parse.parse_qs(url.query).get("fuzzy", [""])[0]
+        self.trace("GET %s %s" % (url.path, name))
+        if url.path == "/cards/named" and name and known(name):
+            return self.answer(200, card(name))
+        self.answer(404, {"object": "error", "code": "not_found"})
+
+
+if __name__ == "__main__":
+    port = next((int(a) for a in sys.argv[1:] if a.isdigit()), 8080)
+    print("Scryfall stand-in on http://127.0.0.1:%d" % port, flush=True)
+    HTTPServer(("127.0.0.1", port), StandIn).serve_forever()
@@ -0,0 +1,356 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <utility>
+#include <boost/asio.hpp>
+#include "Command.hpp"
+#include "Messages.hpp"
+#include "Protocol.hpp"
+#include "Framing.hpp"
+#include "SendQueue.hpp"
+
+/*
+  Headless load generator for server_app.
+  Opens many connections, uploads decks and replays a scripted
+  sequence of commands on each of them, using the same framing and
+  binary protocol of the graphical client. At the end it reports the
+  throughput and the round-trip latency distribution of the commands.
+
+  Usage: ./bot_app [--host 127.0.0.1] [--port 5000] [--connections 10]
+                   [--threads 1] [--decks DIR] [--script FILE]
+                   [--rate 0] [--duration 10]
+
+  The script has one command per line:
+    upload            uploads the deck assigned to the connection
+    pass              passes priority
+    play TARGET EXTRA plays a card
+    stops OWN OPP     sets the auto-pass stops, e.g. "stops main1,main2 end"
+    yield             passes until the end of the turn
+    resign / quit     ends the session of the connection
+  Lines starting with '#' are ignored. The script is repeated until
+  the duration expires. With --rate 0 every connection sends the next
+  command as soon as the previous answer arrives (closed loop),
+  otherwise it sends RATE commands per second without waiting.
+*/
+
+using boost::asio::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+struct BotConfig {
+  std::string host = "127.0.0.1";
+  unsigned short port = 5000;
+  unsigned connections = 10;
+  unsigned threads = 1;
+  std::string decks_dir;
+  std::string script_path;
+  double rate = 0; // commands per second per connection, 0 = closed loop
+  double duration = 10; // seconds
+};
+
+struct BotStats {
+  std::vector<uint32_t> latencies_us;
+  uint64_t sent = 0;
+  uint64_t received = 0;
+  uint64_t errors = 0;
+};
+
+bool is_unsolicited(const std::string& message) {
+  // Messages the server sends on its own, not as a command answer.
+  return message == MESSAGE_connection_established ||
+         message.rfind(MESSAGE_session_token, 0) == 0 ||
+         message.rfind("2 players are connected", 0) == 0 ||
+         message.rfind("Player ", 0) == 0 ||
+         message.rfind(MESSAGE_public_state, 0) == 0 ||
+         message.rfind(MESSAGE_actions, 0) == 0 ||
+         message.rfind(MESSAGE_deck_corrections, 0) == 0;
+}
+
+class BotConnection : public std::enable_shared_from_this<BotConnection> {
+public:
+  BotConnection(boost::asio::io_context& io, const BotConfig& config,
+                const std::vector<Command>& script, const std::string& deck,
+                Clock::time_point deadline)
+    : strand(boost::asio::make_strand(io)), socket(strand), timer(strand),
+      config(config), script(script), deck(deck), deadline(deadline),
+      next_command(0), started(false), finished(false) {}
+
+  void start(const tcp::endpoint& endpoint) {
+    auto self = shared_from_this();
+    socket.async_connect(endpoint, [self](boost::system::error_code ec) {
+      if (ec) {
+        self->stats.errors++;
+        return;
+      }
+      // Take a new seat, the server answers with its greeting.
+      self->send_queue.push(std::make_shared<const std::string>(
+        make_command_frame(Command(CommandCode::Join))));
+      self->flush();
+      self->start_read();
+    });
+  }
+
+  const BotStats& get_stats() const { return stats; }
+
+private:
+  void start_read() {
+    auto self = shared_from_this();
+    boost::asio::async_read(socket,
+      boost::asio::buffer(reader.header_data(), reader.header_size()),
+      [self](boost::system::error_code ec, std::size_t) {
+        if (ec || !self->reader.begin()) {
+          self->stop(ec);
+          return;
+        }
+        self->read_body();
+      });
+  }
+
+  void read_body() {
+    size_t chunk_size;
+    char* chunk = reader.next_chunk(chunk_size);
+    auto self = shared_from_this();
+    boost::asio::async_read(socket, boost::asio::buffer(chunk, chunk_size),
+      [self](boost::system::error_code ec, std::size_t length) {
+        if (ec) {
+          self->stop(ec);
+          return;
+        }
+        if (!self->reader.consume(length)) {
+          self->read_body();
+          return;
+        }
+        std::string message(self->reader.data(), self->reader.size());
+        self->reader.reset();
+        self->handle_message(message);
+        self->start_read();
+      });
+  }
+
+  void handle_message(const std::string& message) {
+    if (!started) {
+      // The server greets every connection, then the script can start.
+      started = true;
+      if (config.rate > 0) {
+        schedule_next();
+      } else {
+        watch_deadline();
+        send_next();
+      }
+      return;
+    }
+    if (is_unsolicited(message) || in_flight.empty()) return;
+    auto elapsed = Clock::now() - in_flight.front();
+    in_flight.pop_front();
+    stats.received++;
+    stats.latencies_us.push_back(static_cast<uint32_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+    if (config.rate <= 0) send_next();
+  }
+
+  void watch_deadline() {
+    // Closed loop: don't wait forever for an answer that never comes.
+    timer.expires_at(deadline + std::chrono::seconds(1));
+    auto self = shared_from_this();
+    timer.async_wait([self](boost::system::error_code ec) {
+      if (!ec) self->stop(boost::system::error_code());
+    });
+  }
+
+  void schedule_next() {
+    // Open loop: one command every 1/rate seconds.
+    timer.expires_after(std::chrono::microseconds(static_cast<long long>(1e6 / config.rate)));
+    auto self = shared_from_this();
+    timer.async_wait([self](boost::system::error_code ec) {
+      if (ec) return;
+      self->send_next();
+      if (!self->finished) self->schedule_next();
+    });
+  }
+
+  void send_next() {
+    if (finished) return;
+    if (Clock::now() >= deadline || script.empty()) {
+      stop(boost::system::error_code());
+      return;
+    }
+    Command command = script[next_command];
+    next_command = (next_command + 1) % script.size();
+    if (command.code == CommandCode::UploadDeck) {
+      command.target = deck;
+    }
+    send_queue.push(std::make_shared<const std::string>(make_command_frame(command)));
+    flush();
+    stats.sent++;
+    if (command.code == CommandCode::Quit || command.code == CommandCode::Resign) {
+      finished = true; // no answer expected, the session is over
+      return;
+    }
+    in_flight.push_back(Clock::now());
+  }
+
+  void flush() {
+    if (!send_queue.start()) return;
+    auto self = shared_from_this();
+    boost::asio::async_write(socket, send_queue.buffers(),
+      [self](boost::system::error_code ec, std::size_t) {
+        self->send_queue.done();
+        if (ec) {
+          self->stop(ec);
+          return;
+        }
+        self->flush();
+      });
+  }
+
+  void stop(boost::system::error_code ec) {
+    if (ec && ec != boost::asio::error::eof && !finished) stats.errors++;
+    finished = true;
+    timer.cancel();
+    boost::system::error_code ignored;
+    socket.close(ignored);
+  }
+
+  boost::asio::strand<boost::asio::io_context::executor_type> strand;
+  tcp::socket socket;
+  boost::asio::steady_timer timer;
+  const BotConfig& config;
+  const std::vector<Command>& script;
+  const std::string& deck;
+  Clock::time_point deadline;
+  FrameReader reader;
+  SendQueue send_queue;
+  std::deque<Clock::time_point> in_flight;
+  size_t next_command;
+  bool started;
+  bool finished;
+  BotStats stats;
+};
+
+std::vector<Command> load_script(const std::string& path) {
+  std::vector<Command> script;
+  if (path.empty()) {
+    script = {Command(CommandCode::UploadDeck), Command(CommandCode::PassPriority)};
+    return script;
+  }
+  std::ifstream is(path);
+  if (!is) {
+    throw std::runtime_error("cannot open script " + path);
+  }
+  std::string line;
+  while (std::getline(is, line)) {
+    std::stringstream ls(line);
+    std::string word, target, extra;
+    ls >> word >> target >> extra;
+    if (word.empty() || word[0] == '#') continue;
+    if (word == "upload") script.emplace_back(CommandCode::UploadDeck);
+    else if (word == "pass") script.emplace_back(CommandCode::PassPriority);
+    else if (word == "play") script.emplace_back(CommandCode::PlayCard, target, extra);
+    else if (word == "stops") script.emplace_back(CommandCode::SetStops, target, extra);
+    else if (word == "yield") script.emplace_back(CommandCode::YieldTurn);
+    else if (word == "resign") script.emplace_back(CommandCode::Resign);
+    else if (word == "quit") script.emplace_back(CommandCode::Quit);
+    else throw std::runtime_error("unknown script command: " + word);
+  }
+  return script;
+}
+
+std::vector<std::string> load_decks(const std::string& dir) {
+  std::vector<std::string> decks;
+  if (dir.empty()) {
+    decks.push_back("4 Lightning Bolt\r\n56 Mountain\r\n\r\n4 Pyroblast\r\n");
+    return decks;
+  }
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    if (!entry.is_regular_file()) continue;
+    std::ifstream is(entry.path());
+    decks.emplace_back((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  }
+  if (decks.empty()) {
+    throw std::runtime_error("no decks found in " + dir);
+  }
+  return decks;
+}
+
+BotConfig parse_args(int argc, char* argv[]) {
+  BotConfig config;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string key = argv[i];
+    std::string value = argv[i + 1];
+    if (key == "--host") config.host = value;
+    else if (key == "--port") config.port = static_cast<unsigned short>(std::stoul(value));
+    else if (key == "--connections") config.connections = std::stoul(value);
+    else if (key == "--threads") config.threads = std::max(1ul, std::stoul(value));
+    else if (key == "--decks") config.decks_dir = value;
+    else if (key == "--script") config.script_path = value;
+    else if (key == "--rate") config.rate = std::stod(value);
+    else if (key == "--duration") config.duration = std::stod(value);
+    else throw std::runtime_error("unknown option " + key);
+  }
+  return config;
+}
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+  return sorted[index];
+}
+
+int main(int argc, char* argv[]) {
+  try {
+    BotConfig config = parse_args(argc, argv);
+    std::vector<Command> script = load_script(config.script_path);
+    std::vector<std::string> decks = load_decks(config.decks_dir);
+
+    boost::asio::io_context io(static_cast<int>(config.threads));
+    tcp::endpoint endpoint(boost::asio::ip::make_address(config.host), config.port);
+    auto begin = Clock::now();
+    auto deadline = begin + std::chrono::microseconds(static_cast<long long>(config.duration * 1e6));
+    std::vector<std::shared_ptr<BotConnection>> bots;
+    for (unsigned i = 0; i < config.connections; i++) {
+      bots.push_back(std::make_shared<BotConnection>(io, config, script,
+                                                     decks[i % decks.size()], deadline));
+      bots.back()->start(endpoint);
+    }
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < config.threads; i++) {
+      pool.emplace_back([&io]() { io.run(); });
+    }
+    io.run();
+    for (auto& t : pool) {
+      t.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    BotStats total;
+    for (auto& bot : bots) {
+      const BotStats& s = bot->get_stats();
+      total.sent += s.sent;
+      total.received += s.received;
+      total.errors += s.errors;
+      total.latencies_us.insert(total.latencies_us.end(), s.latencies_us.begin(), s.latencies_us.end());
+    }
+    std::sort(total.latencies_us.begin(), total.latencies_us.end());
+    std::cout << "connections: " << config.connections
+              << ", elapsed: " << std::fixed << std::setprecision(2) << elapsed << " s\n"
+              << "commands sent: " << total.sent << ", answered: " << total.received
+              << ", errors: " << total.errors << "\n"
+              << "throughput: " << std::setprecision(1) << total.received / elapsed << " commands/s\n"
+              << "latency us: p50 " << percentile(total.latencies_us, 0.50)
+              << ", p99 " << percentile(total.latencies_us, 0.99)
+              << ", p999 " << percentile(total.latencies_us, 0.999)
+              << ", max " << (total.latencies_us.empty() ? 0 : total.latencies_us.back()) << "\n";
+  } catch (std::exception& e) {
+    std::cerr << "Bot exception: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -11,8 +11,10 @@
 #include <atomic>
 #include <mutex>
 #include <queue>
+#include <map>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
+#include <utility>
 #include <boost/asio.hpp>
 #include <nlohmann/json.hpp>
 #include "PublicInfo.hpp" 
@@ -20,8 +22,11 @@
 #include "PlayerInfo.hpp"
 #include "sprites.hpp"
 #include "Command.hpp"
+#include "Protocol.hpp"
+#include "Framing.hpp"
 #include "DeckVisualizer.hpp"
 #include "Messages.hpp"
+#include "Log.hpp"
 #include "tinyfiledialogs.h"
 #include "Utils.hpp"
 #include "RecentDecksPopup.hpp"
@@ -45,10 +50,13 @@ private:
   PublicInfo info;
   std::atomic<bool> connected;
 
-  std::vector<char> read_buffer;
-  uint32_t expected_message_length;
+  FrameReader reader;
   std::vector<CommandCode> available_commands;
+  std::map<unsigned, std::string> playable_cards; // card id -> action, kept from the Actions diffs
   std::string last_deck;
+  std::string host;
+  int port;
+  std::string session_token; // given by the server, used to reconnect
   
   // Thread management
   std::thread network_thread;
@@ -63,10 +71,7 @@ private:
 public:
   PlayerInfo player_info;
   GameClient() 
-  : socket(io_context), connected(false), 
-    expected_message_length(0), deck_parsed(false){
-    read_buffer.resize(65536); // 64KB buffer
-  }
+  : socket(io_context), connected(false), port(0), deck_parsed(false){}
   
   ~GameClient() {
     disconnect();
@@ -74,21 +79,66 @@ public:
       network_thread.join();
     }
   }
+  std::string describe_actions() {
+    // "play <id>" arguments the server would accept now.
+    std::lock_guard<std::mutex> lock(data_mutex);
+    if (playable_cards.empty()) return "Nothing to play.";
+    std::string text = "Playable:";
+    for (const auto& [id, action] : playable_cards) text += " " + std::to_string(id) + " (" + action + ")";
+    return text;
+  }
+
   std::vector<Card> get_main(){
     return player_info.main; 
   } 
   void connect_to_server(const std::string& host, int port) {
+    this->host = host;
+    this->port = port;
     try {
       auto endpoint = tcp::endpoint(boost::asio::ip::make_address(host), port);
       socket.connect(endpoint);
       connected = true;
+      send_command(Command(CommandCode::Join));
       
       // Start network thread
       network_thread = std::thread([this]() {
           network_loop();
       });
     } catch (const std::exception& e) {
-      std::cerr << "Connection failed: " << e.what() << "\n";
+      LOG_ERROR(Client, "Connection failed: ", e.what());
+      connected = false;
+    }
+  }
+  void reconnect() {
+    // Take back the seat held by the server after a disconnection.
+    if (connected) {
+      push_message("Already connected to server.");
+      return;
+    }
+    if (network_thread.joinable()) {
+      network_thread.join();
+    }
+    std::string token;
+    {
+      std::lock_guard<std::mutex> lock(data_mutex);
+      token = session_token;
+    }
+    try {
+      io_context.restart();
+      reader.reset();
+      socket = tcp::socket(io_context);
+      socket.connect(tcp::endpoint(boost::asio::ip::make_address(host), port));
+      connected = true;
+      if (token.empty()) {
+        send_command(Command(CommandCode::Join));
+      } else {
+        send_command(Command(CommandCode::Reconnect, token));
+      }
+      network_thread = std::thread([this]() {
+          network_loop();
+      });
+    } catch (const std::exception& e) {
+      push_message("Reconnection failed: " + std::string(e.what()));
       connected = false;
     }
   }
@@ -118,17 +168,10 @@ public:
     // Post the send operation to the network thread
     boost::asio::post(io_context, [this, command]() {
       try {
-        // Serialize command to JSON
-        nlohmann::json j;
-        to_json(j, command);
-        std::string json_str = j.dump();
-        
-        uint32_t len = htonl(static_cast<uint32_t>(json_str.size()));
-        
-        // Send length first
-        boost::asio::write(socket, boost::asio::buffer(&len, sizeof(uint32_t)));
-        // Send message
-        boost::asio::write(socket, boost::asio::buffer(json_str));
+        // Serialize command (binary protocol, see Protocol.hpp)
+        // and send length and message with a single write.
+        std::string frame = make_command_frame(command);
+        boost::asio::write(socket, boost::asio::buffer(frame));
           
           // push_message("Command sent: " + command.toString());
       } catch (const std::exception& e) {
@@ -254,31 +297,44 @@ private:
     if (!connected) return;
     // Read message length (4 bytes)
     boost::asio::async_read(socket,
-      boost::asio::buffer(&expected_message_length, sizeof(uint32_t)),
+      boost::asio::buffer(reader.header_data(), reader.header_size()),
       [this](boost::system::error_code ec, std::size_t length) {
         if (!ec) {
-          expected_message_length = ntohl(expected_message_length);
-          // Read the actual message
-          boost::asio::async_read(socket,
-            boost::asio::buffer(read_buffer.data(), expected_message_length),
-            [this](boost::system::error_code ec, std::size_t length) {
-              if (!ec) {
-                std::string message(read_buffer.begin(), 
-                                  read_buffer.begin() + expected_message_length);
-                handle_message(message); 
-                start_read(); // Continue reading
-              } else {
-                  handle_disconnect();
-              }
-            });
+          if (!reader.begin()) {
+            push_message("Server sent an oversized message");
+            handle_disconnect();
+            return;
+          }
+          read_body();
         } else {
             handle_disconnect();
         }
     });
   }
+
+  void read_body() {
+    // Read the actual message, one chunk at a time (see Framing.hpp).
+    size_t chunk_size;
+    char* chunk = reader.next_chunk(chunk_size);
+    boost::asio::async_read(socket,
+      boost::asio::buffer(chunk, chunk_size),
+      [this](boost::system::error_code ec, std::size_t length) {
+        if (!ec) {
+          if (!reader.consume(length)) {
+            read_body(); // more chunks to come
+            return;
+          }
+          std::string message(reader.data(), reader.size());
+          reader.reset();
+          handle_message(message);
+          start_read(); // Continue reading
+        } else {
+            handle_disconnect();
+        }
+      });
+  }
     
   bool parse_deck(std::string &raw_data){
-    std::cout<<"parse_deck -> starting deck_parsing..."<<std::endl;
     player_info.main.clear();
     player_info.side.clear();
     std::stringstream is(raw_data);
@@ -288,24 +344,21 @@ private:
     std::string name;
     while(true){
       if(!std::getline(is,line)){
-        std::cout<<"Reached end of list.\n";
         return true;
       }
       std::stringstream is_line(line);
       is_line>>copies;
       is_line.ignore(1);
       if(!std::getline(is_line,name)){
-        std::cout<<"Something went wrong during parsing.\n";
+        LOG_WARN(Client, "Something went wrong during parsing: ", line);
         return false;
       }
       name.pop_back(); // remove newline from card name.
-      for(int i = 0; i < copies; i++){
-        // add card to either sideboard or main deck
-        if(sideboard)
-          player_info.side.emplace_back(0, name, "", "", 0);
-        else
-          player_info.main.emplace_back(0, name, "", "", 0);
-      }
+      // add the copies to either sideboard or main deck
+      CardDefinitionId definition = CardDefinitions::instance().intern(name);
+      auto& zone = sideboard ? player_info.side : player_info.main;
+      if(copies > 0)
+        zone.insert(zone.end(), copies, Card(0, definition));
       if((int)is.peek() == 13){
         sideboard = true;
         is.ignore(2); // ignore carriage return and newline.
@@ -317,11 +370,50 @@ private:
   void handle_message(const std::string& message) {
     // Push message to queue for UI thread to process
     push_message("Server: " + message);
-    std::cout<<"[handle_message]: received " + message + "\n"; 
+    LOG_DEBUG(Client, "Received ", message);
+    if (message.rfind(MESSAGE_session_token, 0) == 0) {
+      std::lock_guard<std::mutex> lock(data_mutex);
+      session_token = message.substr(std::strlen(MESSAGE_session_token));
+      return;
+    }
+    if (message.rfind(MESSAGE_snapshot, 0) == 0) {
+      // After a reconnection the server tells whether the deck
+      // uploaded before the disconnection was accepted.
+      try {
+        auto snapshot = nlohmann::json::parse(message.substr(std::strlen(MESSAGE_snapshot)));
+        if (snapshot.value("validated", false) && !last_deck.empty() && parse_deck(last_deck)) {
+          deck_parsed.store(true);
+        }
+      } catch (const nlohmann::json::exception& e) {
+        LOG_WARN(Client, "Invalid snapshot: ", e.what());
+      }
+      return;
+    }
+    if (message.rfind(MESSAGE_actions, 0) == 0) {
+      // Only the changes are sent, "reset" starts over.
+      try {
+        auto actions = nlohmann::json::parse(message.substr(std::strlen(MESSAGE_actions)));
+        std::lock_guard<std::mutex> lock(data_mutex);
+        if (actions.value("reset", false)) playable_cards.clear();
+        if (actions.contains("commands")) {
+          available_commands.clear();
+          for (const auto& name : actions["commands"]) {
+            available_commands.push_back(commandCodeFromString(name.get<std::string>()));
+          }
+        }
+        for (const auto& id : actions["remove"]) playable_cards.erase(id.get<unsigned>());
+        for (const auto& card : actions["add"]) {
+          playable_cards[card["id"].get<unsigned>()] = card["action"].get<std::string>();
+        }
+      } catch (const nlohmann::json::exception& e) {
+        LOG_WARN(Client, "Invalid actions: ", e.what());
+      }
+      return;
+    }
     // Handle priority updates
     if (message == MESSAGE_correct_deck_upload){
       if(parse_deck(last_deck)){
-        std::cout<<"[handle_message] Parsing succeded.\n";
+        LOG_DEBUG(Client, "Deck parsed: ", player_info.main.size(), " main, ", player_info.side.size(), " sideboard");
         deck_parsed.store(true);
       }
     } 
@@ -526,13 +618,13 @@ int main() {
         0
       );
       if (path) {
-        std::cout << "User selected " << path << std::endl;
+        LOG_DEBUG(Client, "User selected ", path);
         Command cmd = client.create_command_from_input(CommandCode::UploadDeck, path);
         if (cmd.code != CommandCode::Invalid) {
           client.send_command(cmd);
         }
       } else {
-        std::cout << "User cancelled." << std::endl;
+        LOG_DEBUG(Client, "User cancelled.");
         message_log.add_message("File selection cancelled");
       }
     });
@@ -661,6 +753,22 @@ int main() {
                   SDL_Quit();
               } else if (command_text == "resign") {
                   client.send_command(Command(CommandCode::Resign));
+              } else if (command_text == "reconnect") {
+                  client.reconnect();
+              } else if (command_text == "pass") {
+                  client.send_command(Command(CommandCode::PassPriority));
+              } else if (command_text == "actions") {
+                  message_log.add_message(client.describe_actions());
+              } else if (command_text == "yield") {
+                  client.send_command(Command(CommandCode::YieldTurn));
+              } else if (command_text.find("play ") == 0) {
+                  client.send_command(Command(CommandCode::PlayCard, command_text.substr(5)));
+              } else if (command_text.find("stops") == 0) {
+                  // "stops main1,main2 end": own turns, then opponent turns
+                  std::stringstream is(command_text.substr(5));
+                  std::string own, opponent;
+                  is >> own >> opponent;
+                  client.send_command(Command(CommandCode::SetStops, own, opponent));
               }else if (command_text.find("upload ") == 0) {
                 std::string path = command_text.substr(7);
                 Command cmd = client.create_command_from_input(CommandCode::UploadDeck, path);
@@ -801,7 +909,8 @@ int main() {
       SDL_RenderFillRect(renderer, &status_rect);
        
       // Draw help text
-      render_text(renderer, font, "Commands: upload, quit", 
+      render_text(renderer, font,
+               "Commands: upload <deck>, play <id>, pass, yield, actions, stops <own> <opponent>, resign, reconnect, quit",
                MARGIN, 10, {200, 200, 200, 255});
       // Always render floating window on top if visible (as a floating window)
       if (recent_decks_popup.visible()) {
@@ -1,38 +1,37 @@
 #include <string>
 #include <nlohmann/json.hpp>
+#include "CardDefinitions.hpp"
 #pragma once
 class Card {
 public:
 
-    unsigned id;
-    std::string title;
-    std::string effect;
-    std::string type;
-    int cmc;
+    unsigned id; // instance id, unique inside a game
+    CardDefinitionId definition; // see CardDefinitions.hpp
 
-    Card() = default;
-    
-    Card( const unsigned id_,
-          const std::string& t, 
-          const std::string& e, 
-          const std::string & p,
-          const unsigned cmc_
-        )
-        : id(id_), title(t), effect(e), type(p), cmc(cmc_){}
+    Card() : id(0), definition(0) {}
+
+    Card(const unsigned id_, const CardDefinitionId definition_)
+        : id(id_), definition(definition_) {}
+
+    const CardDefinition& info() const { return CardDefinitions::instance().get(definition); }
+    const std::string& title() const { return info().title; }
+    const std::string& effect() const { return info().effect; }
+    const std::string& type() const { return info().type; }
+    int cmc() const { return info().cmc; }
 
     // Optional: a method to display card info as a string
     std::string toString() const {
-        return "Title: " + title + "\nEffect: ";
+        return "Title: " + title() + "\nEffect: ";
     }
 };
 
 inline void to_json(nlohmann::json& j, const Card& c) {
-    j = nlohmann::json{{"title", c.title}, {"effect", c.effect}, {"id", c.id}, {"type", c.type}};
+    j = nlohmann::json{{"title", c.title()}, {"effect", c.effect()}, {"id", c.id}, {"type", c.type()}};
 }
 
 inline void from_json(const nlohmann::json& j, Card& c) {
-    j.at("title").get_to(c.title);
-    j.at("effect").get_to(c.effect);
     j.at("id").get_to(c.id);
-    j.at("type").get_to(c.type);
+    c.definition = CardDefinitions::instance().intern(j.at("title").get<std::string>(),
+                                                      j.at("effect").get<std::string>(),
+                                                      j.at("type").get<std::string>());
 }
@@ -0,0 +1,83 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+  Process-wide table of card definitions: what a card is (name, text,
+  type, cost), shared by all the copies of the card in every game.
+  A Card only holds the index of its definition, so a 60 card deck is
+  60 pairs of integers instead of 180 strings, and grouping or comparing
+  cards compares integers.
+  Definitions are interned by title, never change and are never freed:
+  get() indexes fixed size chunks without locking, only intern() locks.
+  Index 0 is the blank definition of a default constructed Card; it is
+  also returned once the table is full, so that names coming from the
+  network can't grow it without bounds.
+*/
+
+#define CARD_DEFINITIONS_CHUNK 1024
+#define CARD_DEFINITIONS_MAX_CHUNKS 256 // 262144 definitions
+
+using CardDefinitionId = uint32_t;
+
+struct CardDefinition {
+  std::string title;
+  std::string effect;
+  std::string type;
+  int cmc = 0;
+};
+
+class CardDefinitions {
+public:
+  static CardDefinitions& instance() {
+    static CardDefinitions definitions;
+    return definitions;
+  }
+
+  CardDefinitionId intern(const std::string& title, const std::string& effect = "",
+                          const std::string& type = "", int cmc = 0) {
+    // The first definition of a title wins.
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(title);
+    if (it != ids.end()) return it->second;
+    CardDefinitionId id = static_cast<CardDefinitionId>(ids.size());
+    size_t chunk = id / CARD_DEFINITIONS_CHUNK;
+    if (chunk >= CARD_DEFINITIONS_MAX_CHUNKS) return 0;
+    CardDefinition* slots = chunks[chunk].load(std::memory_order_relaxed);
+    if (!slots) {
+      slots = new CardDefinition[CARD_DEFINITIONS_CHUNK];
+      chunks[chunk].store(slots, std::memory_order_release);
+    }
+    slots[id % CARD_DEFINITIONS_CHUNK] = CardDefinition{title, effect, type, cmc};
+    ids.emplace(title, id);
+    return id;
+  }
+
+  const CardDefinition& get(CardDefinitionId id) const {
+    // Ids only come from intern(), so their chunk exists.
+    return chunks[id / CARD_DEFINITIONS_CHUNK].load(std::memory_order_acquire)[id % CARD_DEFINITIONS_CHUNK];
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ids.size();
+  }
+
+  ~CardDefinitions() {
+    for (auto& chunk : chunks) delete[] chunk.load(std::memory_order_relaxed);
+  }
+
+private:
+  CardDefinitions() {
+    for (auto& chunk : chunks) chunk.store(nullptr, std::memory_order_relaxed);
+    intern("");
+  }
+
+  std::array<std::atomic<CardDefinition*>, CARD_DEFINITIONS_MAX_CHUNKS> chunks;
+  std::unordered_map<std::string, CardDefinitionId> ids;
+  std::mutex mutex;
+};
@@ -0,0 +1,376 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CARD_INDEX_FILE "data/cards.bin"
+#define CARD_INDEX_MAGIC "PSIMCDB1"
+#define CARD_INDEX_VERSION 1
+#define CARD_INDEX_FORMATS 24 // room for the formats listed in cardFormats()
+#define CARD_INDEX_IMAGES 3 // png, normal, small
+
+/*
+  Binary card database, written by ingest_app from a Scryfall bulk
+  export and memory mapped by the client and the server at startup.
+  Layout (host byte order, every section 8 byte aligned):
+    CardIndexHeader
+    CardIndexRecord[card_count]  fixed size, strings are references
+    CardIndexBucket[bucket_count]  open addressing hash of the names
+    string pool  UTF-8, not terminated
+  Names are hashed lowercased (ASCII only, like the decklists); double
+  faced cards are also indexed by their front face. A lookup hashes the
+  name, probes a few buckets and compares one or two strings in place:
+  nothing is parsed or copied.
+  open() checks the header and that every reference stays inside the
+  file, so a truncated or foreign file is refused instead of read out
+  of bounds.
+*/
+
+enum class CardLegality : uint8_t {
+  Unknown = 0, // format missing from the export
+  Legal,
+  NotLegal,
+  Restricted,
+  Banned
+};
+
+inline const std::array<const char*, 22>& cardFormats() {
+  // Index of a format in CardIndexRecord::legalities, never reorder.
+  static const std::array<const char*, 22> formats = {
+    "standard", "future", "historic", "timeless", "gladiator", "pioneer", "explorer", "modern",
+    "legacy", "pauper", "vintage", "penny", "commander", "oathbreaker", "standardbrawl", "brawl",
+    "alchemy", "paupercommander", "duel", "oldschool", "premodern", "predh"};
+  return formats;
+}
+
+inline int cardFormatIndex(std::string_view format) {
+  const auto& formats = cardFormats();
+  for (size_t i = 0; i < formats.size(); i++) {
+    if (format == formats[i]) return static_cast<int>(i);
+  }
+  return -1;
+}
+
+inline CardLegality cardLegalityFromString(std::string_view status) {
+  if (status == "legal") return CardLegality::Legal;
+  if (status == "not_legal") return CardLegality::NotLegal;
+  if (status == "restricted") return CardLegality::Restricted;
+  if (status == "banned") return CardLegality::Banned;
+  return CardLegality::Unknown;
+}
+
+enum CardColor : uint8_t { ColorWhite = 1, ColorBlue = 2, ColorBlack = 4, ColorRed = 8, ColorGreen = 16 };
+
+inline uint8_t cardColorFromString(std::string_view color) {
+  if (color == "W") return ColorWhite;
+  if (color == "U") return ColorBlue;
+  if (color == "B") return ColorBlack;
+  if (color == "R") return ColorRed;
+  if (color == "G") return ColorGreen;
+  return 0;
+}
+
+struct CardIndexString {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct CardIndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t card_count;
+  uint32_t bucket_count; // power of two
+  uint32_t reserved;
+  uint64_t records_offset;
+  uint64_t buckets_offset;
+  uint64_t strings_offset;
+  uint64_t strings_size;
+};
+
+struct CardIndexRecord {
+  CardIndexString name;
+  CardIndexString oracle_id;
+  CardIndexString type_line;
+  CardIndexString mana_cost;
+  CardIndexString oracle_text;
+  CardIndexString images[CARD_INDEX_IMAGES];
+  float cmc;
+  uint8_t colors; // CardColor bits
+  uint8_t legalities[CARD_INDEX_FORMATS]; // CardLegality, by cardFormatIndex
+  uint8_t padding[3];
+};
+
+struct CardIndexBucket {
+  uint32_t hash;
+  uint32_t record; // UINT32_MAX when empty
+};
+
+static_assert(sizeof(CardIndexHeader) == 56, "CardIndexHeader is a file format");
+static_assert(sizeof(CardIndexRecord) == 96, "CardIndexRecord is a file format");
+
+inline uint32_t cardNameHash(std::string_view name) {
+  // FNV-1a of the lowercased name.
+  uint32_t hash = 2166136261u;
+  for (unsigned char c : name) {
+    if (c >= 'A' && c <= 'Z') c = static_cast<unsigned char>(c - 'A' + 'a');
+    hash = (hash ^ c) * 16777619u;
+  }
+  return hash;
+}
+
+inline bool cardNameEquals(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    unsigned char x = a[i], y = b[i];
+    if (x >= 'A' && x <= 'Z') x = static_cast<unsigned char>(x - 'A' + 'a');
+    if (y >= 'A' && y <= 'Z') y = static_cast<unsigned char>(y - 'A' + 'a');
+    if (x != y) return false;
+  }
+  return true;
+}
+
+inline std::string_view cardFrontFace(std::string_view name) {
+  size_t faces = name.find(" // ");
+  return faces == std::string_view::npos ? name : name.substr(0, faces);
+}
+
+class CardIndex {
+public:
+  CardIndex() = default;
+  CardIndex(const CardIndex&) = delete;
+  CardIndex& operator=(const CardIndex&) = delete;
+  ~CardIndex() { close(); }
+
+  bool open(const std::string& path = CARD_INDEX_FILE) {
+    // False if the file is missing or not a valid index.
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CardIndexHeader)) {
+      ::close(fd);
+      return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file
+    if (mapped == MAP_FAILED) return false;
+    base = static_cast<const char*>(mapped);
+    mapped_size = static_cast<size_t>(st.st_size);
+    if (!validate()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (base) munmap(const_cast<char*>(base), mapped_size);
+    base = nullptr;
+    mapped_size = 0;
+    header = nullptr;
+    records = nullptr;
+    buckets = nullptr;
+    strings = nullptr;
+  }
+
+  bool is_open() const { return base != nullptr; }
+  size_t size() const { return header ? header->card_count : 0; }
+
+  const CardIndexRecord& record(uint32_t i) const { return records[i]; }
+  uint32_t position(const CardIndexRecord* card) const { return static_cast<uint32_t>(card - records); }
+
+  std::string_view string(CardIndexString s) const { return std::string_view(strings + s.offset, s.length); }
+
+  const CardIndexRecord* find(std::string_view name) const {
+    // Case insensitive, by full name or by front face.
+    if (!header || header->bucket_count == 0) return nullptr;
+    uint32_t hash = cardNameHash(name);
+    uint32_t mask = header->bucket_count - 1;
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+      const CardIndexBucket& bucket = buckets[i];
+      if (bucket.record == UINT32_MAX) return nullptr;
+      if (bucket.hash != hash) continue;
+      std::string_view full = string(records[bucket.record].name);
+      if (cardNameEquals(full, name) || cardNameEquals(cardFrontFace(full), name)) return &records[bucket.record];
+    }
+  }
+
+private:
+  bool validate() {
+    if (mapped_size < sizeof(CardIndexHeader)) return false;
+    header = reinterpret_cast<const CardIndexHeader*>(base);
+    if (std::memcmp(header->magic, CARD_INDEX_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->version != CARD_INDEX_VERSION) return false;
+    uint32_t buckets_count = header->bucket_count;
+    if (buckets_count == 0 || (buckets_count & (buckets_count - 1)) != 0) return false;
+    if (!inside(header->records_offset, uint64_t(header->card_count) * sizeof(CardIndexRecord)) ||
+        !inside(header->buckets_offset, uint64_t(buckets_count) * sizeof(CardIndexBucket)) ||
+        !inside(header->strings_offset, header->strings_size)) {
+      return false;
+    }
+    records = reinterpret_cast<const CardIndexRecord*>(base + header->records_offset);
+    buckets = reinterpret_cast<const CardIndexBucket*>(base + header->buckets_offset);
+    strings = base + header->strings_offset;
+    for (uint32_t i = 0; i < header->card_count; i++) {
+      const CardIndexRecord& card = records[i];
+      for (const CardIndexString* s : {&card.name, &card.oracle_id, &card.type_line, &card.mana_cost,
+                                       &card.oracle_text, &card.images[0], &card.images[1], &card.images[2]}) {
+        if (uint64_t(s->offset) + s->length > header->strings_size) return false;
+      }
+    }
+    uint32_t empty = 0;
+    for (uint32_t i = 0; i < buckets_count; i++) {
+      if (buckets[i].record == UINT32_MAX) empty++;
+      else if (buckets[i].record >= header->card_count) return false;
+    }
+    return empty > 0;
+  }
+
+  bool inside(uint64_t offset, uint64_t length) const {
+    return offset % 8 == 0 && offset <= mapped_size && length <= mapped_size - offset;
+  }
+
+  const char* base = nullptr;
+  size_t mapped_size = 0;
+  const CardIndexHeader* header = nullptr;
+  const CardIndexRecord* records = nullptr;
+  const CardIndexBucket* buckets = nullptr;
+  const char* strings = nullptr;
+};
+
+// One card as read from the export, before it's laid out.
+struct CardIndexEntry {
+  std::string name;
+  std::string oracle_id;
+  std::string type_line;
+  std::string mana_cost;
+  std::string oracle_text;
+  std::array<std::string, CARD_INDEX_IMAGES> images; // png, normal, small
+  float cmc = 0;
+  uint8_t colors = 0;
+  std::array<CardLegality, CARD_INDEX_FORMATS> legalities{};
+};
+
+class CardIndexWriter {
+public:
+  bool add(CardIndexEntry&& entry) {
+    // The first card with a name wins, later printings are dropped.
+    if (entry.name.empty() || !names.insert(lowercase(entry.name)).second) return false;
+    CardIndexRecord record{};
+    record.name = intern(entry.name, false);
+    record.oracle_id = intern(entry.oracle_id, false);
+    record.type_line = intern(entry.type_line, true);
+    record.mana_cost = intern(entry.mana_cost, true);
+    record.oracle_text = intern(entry.oracle_text, false);
+    for (size_t i = 0; i < CARD_INDEX_IMAGES; i++) record.images[i] = intern(entry.images[i], false);
+    record.cmc = entry.cmc;
+    record.colors = entry.colors;
+    for (size_t i = 0; i < CARD_INDEX_FORMATS; i++) record.legalities[i] = static_cast<uint8_t>(entry.legalities[i]);
+    records.push_back(record);
+    return true;
+  }
+
+  size_t size() const { return records.size(); }
+
+  bool write(const std::string& path, std::string& error) {
+    // Written next to path and renamed over it, so a running reader
+    // keeps its mapping of the old file.
+    std::vector<CardIndexBucket> buckets = build_buckets();
+    CardIndexHeader header{};
+    std::memcpy(header.magic, CARD_INDEX_MAGIC, sizeof(header.magic));
+    header.version = CARD_INDEX_VERSION;
+    header.card_count = static_cast<uint32_t>(records.size());
+    header.bucket_count = static_cast<uint32_t>(buckets.size());
+    header.records_offset = align(sizeof(CardIndexHeader));
+    header.buckets_offset = align(header.records_offset + records.size() * sizeof(CardIndexRecord));
+    header.strings_offset = align(header.buckets_offset + buckets.size() * sizeof(CardIndexBucket));
+    header.strings_size = pool.size();
+
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+      error = "cannot write " + temporary;
+      return false;
+    }
+    bool ok = put(file, &header, sizeof(header), 0) &&
+              put(file, records.data(), records.size() * sizeof(CardIndexRecord), header.records_offset) &&
+              put(file, buckets.data(), buckets.size() * sizeof(CardIndexBucket), header.buckets_offset) &&
+              put(file, pool.data(), pool.size(), header.strings_offset);
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+      std::remove(temporary.c_str());
+      error = "cannot write " + path;
+      return false;
+    }
+    return true;
+  }
+
+private:
+  static std::string lowercase(std::string_view name) {
+    std::string key(name);
+    for (char& c : key) {
+      if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return key;
+  }
+
+  static uint64_t align(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+  CardIndexString intern(const std::string& s, bool shared) {
+    // Type lines and mana costs repeat a lot, they are stored once.
+    if (shared) {
+      auto it = shared_strings.find(s);
+      if (it != shared_strings.end()) return it->second;
+    }
+    CardIndexString ref{static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(s.size())};
+    pool += s;
+    if (shared) shared_strings.emplace(s, ref);
+    return ref;
+  }
+
+  std::vector<CardIndexBucket> build_buckets() const {
+    // At most half full, so probes stay short.
+    size_t count = 16;
+    while (count < records.size() * 4) count *= 2;
+    std::vector<CardIndexBucket> buckets(count, CardIndexBucket{0, UINT32_MAX});
+    std::unordered_set<std::string> keys;
+    for (uint32_t i = 0; i < records.size(); i++) {
+      std::string_view name(pool.data() + records[i].name.offset, records[i].name.length);
+      keys.insert(lowercase(name));
+    }
+    auto insert = [&](std::string_view key, uint32_t record) {
+      uint32_t hash = cardNameHash(key);
+      size_t i = hash & (count - 1);
+      while (buckets[i].record != UINT32_MAX) i = (i + 1) & (count - 1);
+      buckets[i] = CardIndexBucket{hash, record};
+    };
+    for (uint32_t i = 0; i < records.size(); i++) {
+      std::string_view name(pool.data() + records[i].name.offset, records[i].name.length);
+      insert(name, i);
+      std::string_view front = cardFrontFace(name);
+      // The front face only if no card has that full name.
+      if (front.size() != name.size() && keys.insert(lowercase(front)).second) insert(front, i);
+    }
+    return buckets;
+  }
+
+  static bool put(FILE* file, const void* data, size_t size, uint64_t offset) {
+    if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0) return false;
+    return size == 0 || std::fwrite(data, 1, size, file) == size;
+  }
+
+  std::vector<CardIndexRecord> records;
+  std::string pool;
+  std::unordered_set<std::string> names;
+  std::unordered_map<std::string, CardIndexString> shared_strings;
+};
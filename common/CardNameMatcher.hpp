@@ -0,0 +1,186 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+  Fuzzy lookup of card names, in process, for decklists with typos,
+  missing accents or punctuation, and split cards written in any of
+  their forms ("Fire // Ice", "Fire/Ice", "Fire").
+  Names are normalized (normalizeCardName) before anything else: a
+  normalized hit is an exact match. Otherwise the rarest trigrams of
+  the query select the candidate names through one posting list per
+  trigram, and the closest one by edit distance is accepted if the
+  distance is small for the length of the query (max_distance).
+  add() is for the single thread building the matcher, match() can
+  then be called from any number of threads.
+*/
+
+inline std::string normalizeCardName(std::string_view name) {
+  // Lowercase ASCII, Latin accents dropped, punctuation removed,
+  // '/' and '-' become spaces, spaces collapsed.
+  std::string out;
+  out.reserve(name.size());
+  auto put = [&](char c) {
+    if (c == ' ' && (out.empty() || out.back() == ' ')) return;
+    out.push_back(c);
+  };
+  for (size_t i = 0; i < name.size(); i++) {
+    unsigned char c = static_cast<unsigned char>(name[i]);
+    if (c >= 'A' && c <= 'Z') put(static_cast<char>(c - 'A' + 'a'));
+    else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) put(static_cast<char>(c));
+    else if (c == ' ' || c == '/' || c == '-' || c == '_' || c == '\t') put(' ');
+    else if (c == 0xC3 && i + 1 < name.size()) {
+      // U+00C0 - U+00FF, the accented letters of card names.
+      static const char* folded[64] = {
+        "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+        "d", "n", "o", "o", "o", "o", "o", "", "o", "u", "u", "u", "u", "y", "th", "ss",
+        "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+        "d", "n", "o", "o", "o", "o", "o", "", "o", "u", "u", "u", "u", "y", "th", "y"};
+      unsigned char next = static_cast<unsigned char>(name[i + 1]);
+      if (next >= 0x80 && next < 0xC0) {
+        for (const char* f = folded[next - 0x80]; *f; f++) put(*f);
+        i++;
+      }
+    } else if (c >= 0x80) {
+      // Other UTF-8 sequences (curly quotes, ...) are punctuation here.
+      while (i + 1 < name.size() && (static_cast<unsigned char>(name[i + 1]) & 0xC0) == 0x80) i++;
+    }
+  }
+  if (!out.empty() && out.back() == ' ') out.pop_back();
+  return out;
+}
+
+class CardNameMatcher {
+public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  size_t size() const { return entries.size(); }
+
+  void add(std::string_view name, uint32_t id) {
+    // Split cards are also found by their front face.
+    add_key(normalizeCardName(name), id);
+    size_t faces = name.find("//");
+    if (faces != std::string_view::npos) add_key(normalizeCardName(name.substr(0, faces)), id);
+  }
+
+  uint32_t match(std::string_view query) const {
+    // id given to add() for the closest name, npos if none is close enough.
+    std::string key = normalizeCardName(query);
+    if (key.empty()) return npos;
+    auto exact = by_key.find(key);
+    if (exact != by_key.end()) return entries[exact->second].id;
+
+    // An insertion, deletion or substitution changes at most 3
+    // trigrams, an adjacent swap (one edit for edit_distance) up to 4:
+    // a name within limit edits shares one of any 4 * limit + 1
+    // trigrams of the query, so only the postings of the rarest ones
+    // are read.
+    size_t limit = max_distance(key.size());
+    if (limit == 0) return npos;
+    std::vector<const std::vector<uint32_t>*> postings;
+    for (uint32_t gram : trigrams(key)) {
+      auto it = index.find(gram);
+      postings.push_back(it == index.end() ? &no_entries : &it->second);
+    }
+    std::sort(postings.begin(), postings.end(),
+              [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) { return a->size() < b->size(); });
+    postings.resize(std::min(postings.size(), 4 * limit + 1));
+
+    thread_local std::vector<uint8_t> seen;
+    thread_local std::vector<uint32_t> touched;
+    if (seen.size() < entries.size()) seen.resize(entries.size(), 0);
+    uint32_t best = npos;
+    size_t best_distance = limit + 1;
+    for (const std::vector<uint32_t>* list : postings) {
+      for (uint32_t entry : *list) {
+        if (seen[entry]) continue;
+        seen[entry] = 1;
+        touched.push_back(entry);
+        const std::string& name = entries[entry].key;
+        size_t gap = name.size() > key.size() ? name.size() - key.size() : key.size() - name.size();
+        if (gap >= best_distance) continue;
+        size_t distance = edit_distance(key, name, best_distance);
+        if (distance < best_distance) {
+          best_distance = distance;
+          best = entry;
+        }
+      }
+    }
+    for (uint32_t entry : touched) seen[entry] = 0;
+    touched.clear();
+    return best == npos ? npos : entries[best].id;
+  }
+
+private:
+  struct Entry {
+    std::string key;
+    uint32_t id;
+  };
+
+  void add_key(std::string key, uint32_t id) {
+    if (key.empty() || by_key.count(key)) return;
+    uint32_t entry = static_cast<uint32_t>(entries.size());
+    std::vector<uint32_t> grams = trigrams(key);
+    for (uint32_t gram : grams) index[gram].push_back(entry);
+    by_key.emplace(key, entry);
+    entries.push_back(Entry{std::move(key), id});
+  }
+
+  static std::vector<uint32_t> trigrams(const std::string& key) {
+    // Distinct trigrams of the key padded with spaces, so that the
+    // start and the end of words weigh more.
+    std::string padded = "  " + key + " ";
+    std::vector<uint32_t> grams;
+    grams.reserve(padded.size());
+    for (size_t i = 0; i + 3 <= padded.size(); i++) {
+      grams.push_back(static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16 |
+                      static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8 |
+                      static_cast<unsigned char>(padded[i + 2]));
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+  }
+
+  static size_t max_distance(size_t length) {
+    // Typos tolerated for a query of this length.
+    if (length <= 4) return 0;
+    if (length <= 8) return 1;
+    return 2 + length / 12;
+  }
+
+  static size_t edit_distance(const std::string& a, const std::string& b, size_t limit) {
+    // Optimal string alignment (adjacent swaps count as one), gives
+    // up with limit as soon as every path costs more.
+    thread_local std::vector<size_t> before, previous, current;
+    before.assign(b.size() + 1, 0);
+    previous.assign(b.size() + 1, 0);
+    current.assign(b.size() + 1, 0);
+    for (size_t j = 0; j <= b.size(); j++) previous[j] = j;
+    for (size_t i = 1; i <= a.size(); i++) {
+      current[0] = i;
+      size_t row_min = current[0];
+      for (size_t j = 1; j <= b.size(); j++) {
+        size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+        current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+        if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+          current[j] = std::min(current[j], before[j - 2] + 1);
+        }
+        row_min = std::min(row_min, current[j]);
+      }
+      if (row_min >= limit) return limit;
+      std::swap(before, previous);
+      std::swap(previous, current);
+    }
+    return std::min(previous[b.size()], limit);
+  }
+
+  std::vector<Entry> entries;
+  std::unordered_map<std::string, uint32_t> by_key; // normalized name -> entry
+  std::unordered_map<uint32_t, std::vector<uint32_t>> index; // trigram -> entries, ascending
+  std::vector<uint32_t> no_entries;
+};
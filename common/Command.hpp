@@ -1,17 +1,44 @@
 #pragma once
 #include <string>
+#include <cstdint>
 #include <nlohmann/json.hpp>
 
-enum class CommandCode {
-    PlayCard, // Play a card
-    PassPriority, // Pass priority to other player
-    UploadDeck, // Command to upload deck
-    Resign,
-    Quit,
-    Invalid,
-    Unknown
+// Values are the opcodes of the binary protocol (see Protocol.hpp),
+// never renumber them.
+enum class CommandCode : uint8_t {
+    PlayCard = 0, // Play a card
+    PassPriority = 1, // Pass priority to other player
+    UploadDeck = 2, // Command to upload deck
+    Resign = 3,
+    Quit = 4,
+    Invalid = 5,
+    Join = 6, // First command of a connection: take a new seat
+    Reconnect = 7, // First command of a connection: target is the session token
+    Spectate = 8, // First command of a connection: target is the match id
+    SetStops = 9, // Auto-pass stops: target own turns, extra opponent turns
+    YieldTurn = 10, // Pass priority until the end of the turn
+    Unknown = 0xFF
 };
 
+inline CommandCode commandCodeFromOpcode(uint8_t opcode) {
+    switch (static_cast<CommandCode>(opcode)) {
+        case CommandCode::PlayCard:
+        case CommandCode::PassPriority:
+        case CommandCode::UploadDeck:
+        case CommandCode::Resign:
+        case CommandCode::Quit:
+        case CommandCode::Invalid:
+        case CommandCode::Join:
+        case CommandCode::Reconnect:
+        case CommandCode::Spectate:
+        case CommandCode::SetStops:
+        case CommandCode::YieldTurn:
+            return static_cast<CommandCode>(opcode);
+        default:
+            return CommandCode::Unknown;
+    }
+}
+
 
 inline std::string commandCodeToString(CommandCode code) {
     switch (code) {
@@ -21,6 +48,11 @@ inline std::string commandCodeToString(CommandCode code) {
         case CommandCode::Resign:      return "Resign"; 
         case CommandCode::Quit:        return "Quit"; 
         case CommandCode::Invalid:    return "Invalid"; 
+        case CommandCode::Join:        return "Join";
+        case CommandCode::Reconnect:   return "Reconnect";
+        case CommandCode::Spectate:    return "Spectate";
+        case CommandCode::SetStops:    return "Set Stops";
+        case CommandCode::YieldTurn:   return "Yield Turn";
         default:                       return "Unknown";
     }
 }
@@ -32,6 +64,11 @@ inline CommandCode commandCodeFromString(const std::string& str) {
     if (str == "Resign")        return CommandCode::Resign;
     if (str == "Invalid")        return CommandCode::Invalid;
     if (str == "Quit")          return CommandCode::Quit;
+    if (str == "Join")          return CommandCode::Join;
+    if (str == "Reconnect")     return CommandCode::Reconnect;
+    if (str == "Spectate")      return CommandCode::Spectate;
+    if (str == "Set Stops")     return CommandCode::SetStops;
+    if (str == "Yield Turn")    return CommandCode::YieldTurn;
     return CommandCode::Unknown;
 }
 
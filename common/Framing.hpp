@@ -0,0 +1,156 @@
+#pragma once
+#include <array>
+#include <string>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+/*
+  Incoming side of the length-prefixed framing used on every socket.
+  The 4 bytes length header is read first, then the body is read by
+  the FrameReader in chunks of at most FRAME_CHUNK_SIZE bytes.
+  Small messages (almost every command) land in a buffer embedded in
+  the reader, so an idle connection costs less than a kilobyte.
+  Bigger messages (deck uploads, state snapshots) are read into a
+  buffer taken from a process wide pool that grows one chunk at a
+  time, so a peer announcing a huge length without sending it can't
+  make us allocate it upfront. Lengths above MAX_MESSAGE_SIZE are
+  rejected before reading anything.
+*/
+
+#define MAX_MESSAGE_SIZE (16u * 1024u * 1024u)
+#define SMALL_MESSAGE_SIZE 512
+#define FRAME_CHUNK_SIZE 65536
+// Pooled buffers bigger than this are freed instead of recycled.
+#define POOL_MAX_RETAINED_CAPACITY (1024u * 1024u)
+#define POOL_MAX_BUFFERS 64
+
+inline std::string make_frame(const std::string& payload) {
+  // Length prefix (network order) followed by the payload.
+  std::string frame;
+  frame.reserve(4 + payload.size());
+  uint32_t len = static_cast<uint32_t>(payload.size());
+  frame.push_back(static_cast<char>((len >> 24) & 0xFF));
+  frame.push_back(static_cast<char>((len >> 16) & 0xFF));
+  frame.push_back(static_cast<char>((len >> 8) & 0xFF));
+  frame.push_back(static_cast<char>(len & 0xFF));
+  frame.append(payload);
+  return frame;
+}
+
+/*
+  Immutable encoded frame. A broadcast encodes its frame once and
+  the same buffer is queued on every recipient's socket, so fanning
+  out a message costs a reference count per socket, whatever its size.
+*/
+using SharedFrame = std::shared_ptr<const std::string>;
+
+inline SharedFrame make_shared_frame(const std::string& payload) {
+  return std::make_shared<const std::string>(make_frame(payload));
+}
+
+class BufferPool {
+public:
+  static BufferPool& instance() {
+    static BufferPool pool;
+    return pool;
+  }
+
+  std::vector<char> acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_buffers.empty()) {
+      return std::vector<char>();
+    }
+    std::vector<char> buffer = std::move(free_buffers.back());
+    free_buffers.pop_back();
+    return buffer;
+  }
+
+  void release(std::vector<char>&& buffer) {
+    if (buffer.capacity() == 0 || buffer.capacity() > POOL_MAX_RETAINED_CAPACITY) {
+      return; // let it go, huge snapshots must not pin memory
+    }
+    buffer.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_buffers.size() < POOL_MAX_BUFFERS) {
+      free_buffers.push_back(std::move(buffer));
+    }
+  }
+
+private:
+  BufferPool() = default;
+  std::mutex mutex;
+  std::vector<std::vector<char>> free_buffers;
+};
+
+class FrameReader {
+public:
+  FrameReader() : length(0), received(0) {}
+  ~FrameReader() { reset(); }
+  FrameReader(const FrameReader&) = delete;
+  FrameReader& operator=(const FrameReader&) = delete;
+
+  // Where the 4 bytes header is read into.
+  char* header_data() { return header.data(); }
+  size_t header_size() const { return header.size(); }
+
+  bool begin() {
+    /*
+      Decodes the header (network order) and prepares the body.
+      Returns false if the peer announced a message too big.
+    */
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(header.data());
+    length = (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) |
+             (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+    received = 0;
+    if (length > MAX_MESSAGE_SIZE) {
+      return false;
+    }
+    if (length > SMALL_MESSAGE_SIZE) {
+      large = BufferPool::instance().acquire();
+    }
+    return true;
+  }
+
+  char* next_chunk(size_t& size) {
+    // Buffer for the next read: at most one chunk of the missing bytes.
+    size = std::min<size_t>(length - received, FRAME_CHUNK_SIZE);
+    if (length <= SMALL_MESSAGE_SIZE) {
+      return small.data() + received;
+    }
+    large.resize(received + size);
+    return large.data() + received;
+  }
+
+  bool consume(size_t size) {
+    // Accounts for bytes read into the last chunk.
+    // Returns true once the whole body has been received.
+    received += static_cast<uint32_t>(size);
+    return received >= length;
+  }
+
+  const char* data() const {
+    return length <= SMALL_MESSAGE_SIZE ? small.data() : large.data();
+  }
+  size_t size() const { return length; }
+
+  void reset() {
+    // Gives the big buffer back to the pool, ready for the next header.
+    if (large.capacity() > 0) {
+      BufferPool::instance().release(std::move(large));
+      large = std::vector<char>();
+    }
+    length = 0;
+    received = 0;
+  }
+
+private:
+  std::array<char, 4> header;
+  std::array<char, SMALL_MESSAGE_SIZE> small;
+  std::vector<char> large;
+  uint32_t length;
+  uint32_t received;
+};
@@ -0,0 +1,191 @@
+#pragma once
+#include <curl/curl.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "Log.hpp"
+
+#define IMAGE_DOWNLOADS 8 // transfers in flight at once
+#define IMAGE_DOWNLOAD_RESERVE_MAX (16 << 20) // Content-Length trusted up to this size
+
+/*
+  Downloads images concurrently on one thread with a curl multi handle.
+  Up to parallel transfers run at once, over connections kept alive by
+  the multi handle (and multiplexed when the server speaks HTTP/2);
+  the easy handles are reused from one image to the next and share
+  their DNS and TLS session caches, so only the first transfers to a
+  host pay the lookups and the handshakes.
+  run() pulls the URLs from a callback as slots free up, so the caller
+  can stop feeding it at any time: the transfers in flight still end
+  and are reported.
+  An ImageDownloader is used by one thread at a time.
+*/
+
+struct ImageDownload {
+  std::string url;
+  size_t id = 0; // given back with the data
+};
+
+class ImageDownloader {
+public:
+  explicit ImageDownloader(size_t parallel = IMAGE_DOWNLOADS) : transfers(std::max<size_t>(parallel, 1)) {
+    curl_global_init(CURL_GLOBAL_DEFAULT); // counted, ScryfallAPI does it too
+    share = curl_share_init();
+    if (share) {
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+    multi = curl_multi_init();
+    if (multi) {
+      curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+      curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(transfers.size()));
+    }
+  }
+
+  ~ImageDownloader() {
+    for (Transfer& transfer : transfers) {
+      if (transfer.handle) curl_easy_cleanup(transfer.handle);
+    }
+    if (multi) curl_multi_cleanup(multi);
+    if (share) curl_share_cleanup(share);
+    curl_global_cleanup();
+  }
+
+  ImageDownloader(const ImageDownloader&) = delete;
+  ImageDownloader& operator=(const ImageDownloader&) = delete;
+
+  // next(ImageDownload&) gives the next image to download, false when
+  // there is none left; done(id, data) is called for every image, with
+  // empty data if the download failed. Both run on the calling thread.
+  template <typename Next, typename Done>
+  void run(Next next, Done done) {
+    if (!multi) {
+      ImageDownload download;
+      while (next(download)) done(download.id, std::vector<unsigned char>());
+      return;
+    }
+    size_t active = 0;
+    bool more = true;
+    while (true) {
+      for (Transfer& transfer : transfers) {
+        while (more && !transfer.busy) {
+          ImageDownload download;
+          more = next(download);
+          if (!more) break;
+          if (start(transfer, download)) active++;
+          else done(download.id, std::vector<unsigned char>());
+        }
+      }
+      if (active == 0) break;
+
+      int running = 0;
+      curl_multi_perform(multi, &running);
+      int queued = 0;
+      bool freed = false;
+      while (CURLMsg* message = curl_multi_info_read(multi, &queued)) {
+        if (message->msg != CURLMSG_DONE) continue;
+        Transfer* transfer = nullptr;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+        long code = 0;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &code);
+        if (message->data.result != CURLE_OK) {
+          LOG_ERROR(Scryfall, "Download of ", transfer->url, " failed: ", curl_easy_strerror(message->data.result));
+          transfer->data.clear();
+        } else if (code != 200) {
+          LOG_ERROR(Scryfall, "Download of ", transfer->url, " failed: HTTP ", code);
+          transfer->data.clear();
+        }
+        curl_multi_remove_handle(multi, message->easy_handle);
+        transfer->busy = false;
+        freed = true;
+        active--;
+        done(transfer->id, std::move(transfer->data));
+        transfer->data = std::vector<unsigned char>();
+      }
+      if (!freed && active > 0 && running == 0) {
+        // Nothing left running but no end reported: there is nothing to
+        // wait for, the remaining transfers are failed.
+        for (Transfer& transfer : transfers) {
+          if (!transfer.busy) continue;
+          LOG_ERROR(Scryfall, "Download of ", transfer.url, " failed: ended without a result");
+          curl_multi_remove_handle(multi, transfer.handle);
+          transfer.busy = false;
+          active--;
+          done(transfer.id, std::vector<unsigned char>());
+          transfer.data = std::vector<unsigned char>();
+        }
+        continue;
+      }
+      // A freed slot is given its next image before waiting again.
+      if (!freed && active > 0) curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+  }
+
+  std::vector<unsigned char> fetch(const std::string& url) {
+    std::vector<unsigned char> image;
+    bool given = false;
+    run([&](ImageDownload& download) {
+          if (given) return false;
+          download.url = url;
+          given = true;
+          return true;
+        },
+        [&](size_t, std::vector<unsigned char>&& data) { image = std::move(data); });
+    return image;
+  }
+
+private:
+  struct Transfer {
+    CURL* handle = nullptr; // created on first use, then kept
+    bool busy = false;
+    bool sized = false; // reserved from Content-Length
+    size_t id = 0;
+    std::string url;
+    std::vector<unsigned char> data;
+  };
+
+  static size_t WriteVectorCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t totalSize = size * nmemb;
+    auto* transfer = static_cast<Transfer*>(userp);
+    if (!transfer->sized) {
+      // Grow the buffer once to the announced size instead of doubling
+      // it chunk after chunk.
+      transfer->sized = true;
+      curl_off_t length = -1;
+      curl_easy_getinfo(transfer->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+      if (length > 0 && length <= IMAGE_DOWNLOAD_RESERVE_MAX) transfer->data.reserve(static_cast<size_t>(length));
+    }
+    transfer->data.insert(transfer->data.end(), (unsigned char*)contents, (unsigned char*)contents + totalSize);
+    return totalSize;
+  }
+
+  bool start(Transfer& transfer, const ImageDownload& download) {
+    if (download.url.empty()) return false;
+    if (!transfer.handle) {
+      transfer.handle = curl_easy_init();
+      if (!transfer.handle) return false;
+      curl_easy_setopt(transfer.handle, CURLOPT_FOLLOWLOCATION, 1L);
+      curl_easy_setopt(transfer.handle, CURLOPT_USERAGENT, "ScryfallCppClient/1.0");
+      curl_easy_setopt(transfer.handle, CURLOPT_WRITEFUNCTION, WriteVectorCallback);
+      curl_easy_setopt(transfer.handle, CURLOPT_WRITEDATA, &transfer);
+      curl_easy_setopt(transfer.handle, CURLOPT_PRIVATE, &transfer);
+      curl_easy_setopt(transfer.handle, CURLOPT_SHARE, share);
+      curl_easy_setopt(transfer.handle, CURLOPT_TCP_KEEPALIVE, 1L);
+      curl_easy_setopt(transfer.handle, CURLOPT_PIPEWAIT, 1L); // wait to multiplex rather than open a connection
+      curl_easy_setopt(transfer.handle, CURLOPT_CONNECTTIMEOUT, 10L);
+      curl_easy_setopt(transfer.handle, CURLOPT_TIMEOUT, 60L);
+    }
+    transfer.url = download.url;
+    transfer.id = download.id;
+    transfer.sized = false;
+    transfer.data.clear();
+    curl_easy_setopt(transfer.handle, CURLOPT_URL, transfer.url.c_str());
+    if (curl_multi_add_handle(multi, transfer.handle) != CURLM_OK) return false;
+    transfer.busy = true;
+    return true;
+  }
+
+  std::vector<Transfer> transfers; // never resized: the handles point to them
+  CURLM* multi = nullptr;
+  CURLSH* share = nullptr;
+};
@@ -0,0 +1,308 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+/*
+  Leveled asynchronous logger shared by server and client.
+  Producers format the line straight into a slot of a bounded lock-free
+  ring (multi producer, single consumer, one sequence number per slot)
+  and return: a background thread drains the ring and writes whole
+  batches to stderr or to a file, with one flush per batch.
+  Each subsystem has its own level, checked with a relaxed atomic load
+  by the LOG_* macros before the arguments are even evaluated, so a
+  disabled line costs a few nanoseconds. Levels can be changed at any
+  time with Log::configure(), e.g. "info,match=debug,scryfall=warn"; the
+  initial configuration comes from the PSIM_LOG environment variable
+  and PSIM_LOG_FILE redirects the output to a file.
+  When the ring is full lines are dropped, never waited for: the
+  number of dropped lines is reported by the next batch.
+*/
+
+#define LOG_RING_SIZE 8192 // slots, must be a power of two
+#define LOG_LINE_SIZE 240 // longer lines are truncated
+#define LOG_IDLE_SLEEP_MS 2
+
+enum class LogLevel : uint8_t { Trace = 0, Debug, Info, Warn, Error, Off };
+
+enum class LogSubsystem : uint8_t {
+  Server = 0, // accept loop, lobby, startup
+  Match, // game logic and player connections
+  Deck, // deck validation and card database
+  Storage, // event logs
+  Metrics, // metrics endpoint
+  Scryfall, // Scryfall API and its local cache
+  Client, // client network and game state
+  Ui, // client rendering
+  Count
+};
+
+inline const char* logLevelToString(LogLevel level) {
+  static const char* names[] = {"trace", "debug", "info", "warn", "error", "off"};
+  return names[static_cast<size_t>(level)];
+}
+
+inline const char* logSubsystemToString(LogSubsystem subsystem) {
+  static const char* names[] = {"server", "match", "deck", "storage", "metrics", "scryfall", "client", "ui"};
+  return names[static_cast<size_t>(subsystem)];
+}
+
+class LogLine {
+  // Appends values to a fixed buffer without allocating.
+public:
+  LogLine(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0) {}
+
+  size_t size() const { return length; }
+
+  void append(std::string_view s) {
+    size_t n = std::min(s.size(), capacity - length);
+    std::memcpy(buffer + length, s.data(), n);
+    length += n;
+  }
+  void append(const char* s) { append(std::string_view(s ? s : "(null)")); }
+  void append(const std::string& s) { append(std::string_view(s)); }
+  void append(char c) { if (length < capacity) buffer[length++] = c; }
+  void append(bool b) { append(b ? std::string_view("true") : std::string_view("false")); }
+  template <typename T>
+  std::enable_if_t<std::is_integral_v<T>> append(T value) {
+    auto result = std::to_chars(buffer + length, buffer + capacity, value);
+    if (result.ec == std::errc()) length = result.ptr - buffer;
+  }
+  template <typename T>
+  std::enable_if_t<std::is_floating_point_v<T>> append(T value) {
+    char tmp[32];
+    int n = std::snprintf(tmp, sizeof(tmp), "%g", static_cast<double>(value));
+    if (n > 0) append(std::string_view(tmp, static_cast<size_t>(n)));
+  }
+
+private:
+  char* buffer;
+  size_t capacity;
+  size_t length;
+};
+
+class Log {
+public:
+  static Log& instance() {
+    static Log log;
+    return log;
+  }
+
+  bool enabled(LogSubsystem subsystem, LogLevel level) const {
+    return level >= levels[static_cast<size_t>(subsystem)].load(std::memory_order_relaxed);
+  }
+
+  template <typename... Args>
+  void write(LogSubsystem subsystem, LogLevel level, const Args&... args) {
+    // Claims a slot, formats in place, then publishes it.
+    size_t position = tail.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &ring[position & (LOG_RING_SIZE - 1)];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        dropped.fetch_add(1, std::memory_order_relaxed); // ring full
+        return;
+      } else {
+        position = tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->time = std::chrono::system_clock::now();
+    slot->subsystem = subsystem;
+    slot->level = level;
+    LogLine line(slot->text, LOG_LINE_SIZE);
+    (line.append(args), ...);
+    slot->length = static_cast<uint16_t>(line.size());
+    slot->sequence.store(position + 1, std::memory_order_release);
+  }
+
+  void set_level(LogSubsystem subsystem, LogLevel level) {
+    levels[static_cast<size_t>(subsystem)].store(level, std::memory_order_relaxed);
+  }
+
+  bool configure(const std::string& spec) {
+    /*
+      Comma separated list of "level" (every subsystem) or
+      "subsystem=level" items, applied left to right.
+      Returns false, changing nothing, if an item is not valid.
+    */
+    std::array<LogLevel, static_cast<size_t>(LogSubsystem::Count)> next;
+    for (size_t i = 0; i < next.size(); i++) next[i] = levels[i].load(std::memory_order_relaxed);
+    size_t begin = 0;
+    while (begin <= spec.size()) {
+      size_t end = spec.find(',', begin);
+      if (end == std::string::npos) end = spec.size();
+      std::string item = spec.substr(begin, end - begin);
+      begin = end + 1;
+      if (item.empty()) continue;
+      size_t eq = item.find('=');
+      LogLevel level;
+      if (!parse_level(eq == std::string::npos ? item : item.substr(eq + 1), level)) return false;
+      if (eq == std::string::npos) {
+        next.fill(level);
+        continue;
+      }
+      size_t subsystem;
+      if (!parse_subsystem(item.substr(0, eq), subsystem)) return false;
+      next[subsystem] = level;
+    }
+    for (size_t i = 0; i < next.size(); i++) levels[i].store(next[i], std::memory_order_relaxed);
+    return true;
+  }
+
+  std::string describe() const {
+    std::string out;
+    for (size_t i = 0; i < levels.size(); i++) {
+      out += logSubsystemToString(static_cast<LogSubsystem>(i));
+      out += '=';
+      out += logLevelToString(levels[i].load(std::memory_order_relaxed));
+      out += '\n';
+    }
+    return out;
+  }
+
+  bool open_file(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "a");
+    if (!f) return false;
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if (output != stderr) std::fclose(output);
+    output = f;
+    return true;
+  }
+
+  ~Log() {
+    running.store(false, std::memory_order_relaxed);
+    worker.join();
+    if (output != stderr) std::fclose(output);
+  }
+
+private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    std::chrono::system_clock::time_point time;
+    LogSubsystem subsystem;
+    LogLevel level;
+    uint16_t length;
+    char text[LOG_LINE_SIZE];
+  };
+
+  Log() : tail(0), head(0), dropped(0), output(stderr), running(true) {
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) ring[i].sequence.store(i, std::memory_order_relaxed);
+    for (auto& level : levels) level.store(LogLevel::Info, std::memory_order_relaxed);
+    if (const char* spec = std::getenv("PSIM_LOG")) configure(spec);
+    if (const char* path = std::getenv("PSIM_LOG_FILE")) open_file(path);
+    worker = std::thread([this]() { run(); });
+  }
+
+  static bool parse_level(const std::string& name, LogLevel& level) {
+    for (uint8_t i = 0; i <= static_cast<uint8_t>(LogLevel::Off); i++) {
+      if (name == logLevelToString(static_cast<LogLevel>(i))) {
+        level = static_cast<LogLevel>(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool parse_subsystem(const std::string& name, size_t& subsystem) {
+    for (size_t i = 0; i < static_cast<size_t>(LogSubsystem::Count); i++) {
+      if (name == logSubsystemToString(static_cast<LogSubsystem>(i))) {
+        subsystem = i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run() {
+    // Consumer: drains whatever is ready, writes it with one call.
+    std::string batch;
+    while (true) {
+      bool stopping = !running.load(std::memory_order_relaxed);
+      batch.clear();
+      uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+      if (lost > 0) {
+        batch += "[log] " + std::to_string(lost) + " lines dropped, ring full\n";
+      }
+      while (true) {
+        Slot& slot = ring[head & (LOG_RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1) break;
+        format(slot, batch);
+        slot.sequence.store(head + LOG_RING_SIZE, std::memory_order_release);
+        head++;
+      }
+      if (!batch.empty()) {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::fwrite(batch.data(), 1, batch.size(), output);
+        std::fflush(output);
+      } else if (stopping) {
+        return;
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_IDLE_SLEEP_MS));
+      }
+    }
+  }
+
+  static void format(const Slot& slot, std::string& out) {
+    // "2025-01-01 12:00:00.123456 info  match: text"
+    auto since_epoch = slot.time.time_since_epoch();
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(since_epoch - seconds);
+    std::time_t t = static_cast<std::time_t>(seconds.count());
+    std::tm tm;
+#ifdef _WIN32
+    localtime_s(&tm, &t);
+#else
+    localtime_r(&t, &tm);
+#endif
+    char prefix[64];
+    size_t n = std::strftime(prefix, sizeof(prefix), "%Y-%m-%d %H:%M:%S", &tm);
+    n += std::snprintf(prefix + n, sizeof(prefix) - n, ".%06lld %-5s %s: ",
+                       static_cast<long long>(micros.count()), logLevelToString(slot.level),
+                       logSubsystemToString(slot.subsystem));
+    out.append(prefix, n);
+    // One line per entry: embedded line breaks (e.g. a deck list)
+    // would make the output ambiguous for log processors.
+    for (size_t i = 0; i < slot.length; i++) {
+      char c = slot.text[i];
+      out.push_back(c == '\n' || c == '\r' ? ' ' : c);
+    }
+    out.push_back('\n');
+  }
+
+  std::array<Slot, LOG_RING_SIZE> ring;
+  std::array<std::atomic<LogLevel>, static_cast<size_t>(LogSubsystem::Count)> levels;
+  std::atomic<size_t> tail; // next slot claimed by a producer
+  size_t head; // next slot read by the consumer
+  std::atomic<uint64_t> dropped;
+  std::mutex output_mutex;
+  std::FILE* output;
+  std::atomic<bool> running;
+  std::thread worker;
+};
+
+#define LOG_AT(subsystem, level, ...) \
+  do { \
+    if (Log::instance().enabled(LogSubsystem::subsystem, LogLevel::level)) \
+      Log::instance().write(LogSubsystem::subsystem, LogLevel::level, __VA_ARGS__); \
+  } while (0)
+
+#define LOG_TRACE(subsystem, ...) LOG_AT(subsystem, Trace, __VA_ARGS__)
+#define LOG_DEBUG(subsystem, ...) LOG_AT(subsystem, Debug, __VA_ARGS__)
+#define LOG_INFO(subsystem, ...) LOG_AT(subsystem, Info, __VA_ARGS__)
+#define LOG_WARN(subsystem, ...) LOG_AT(subsystem, Warn, __VA_ARGS__)
+#define LOG_ERROR(subsystem, ...) LOG_AT(subsystem, Error, __VA_ARGS__)
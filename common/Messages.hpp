@@ -4,5 +4,25 @@
 #define MESSAGE_pass_priority "Priority passed.\n"
 #define MESSAGE_processing_command "Processing command...\n"
 #define MESSAGE_no_priority "You don't have priority now. You can only quit or resign.\n"
+#define MESSAGE_invalid_deck "Invalid deck: "
 #define MESSAGE_error_upload "Something went wrong when validating the deck. Try another upload.\n"
 #define MESSAGE_error_unknown_command "Unknown command.\n"
+#define MESSAGE_connection_established "Connection established."
+#define MESSAGE_session_token "Session token: "
+#define MESSAGE_reconnected "Reconnected."
+#define MESSAGE_snapshot "Snapshot: "
+#define MESSAGE_unknown_session "Unknown or expired session, connect again to take a new seat.\n"
+#define MESSAGE_spectating "Spectating match "
+#define MESSAGE_public_state "State: "
+#define MESSAGE_unknown_match "Unknown match, nothing to spectate.\n"
+#define MESSAGE_game_not_started "The game has not started yet.\n"
+#define MESSAGE_deck_locked "The game has started, the deck can't be changed.\n"
+#define MESSAGE_card_played "Card played."
+#define MESSAGE_unknown_card "You have no such card in hand.\n"
+#define MESSAGE_cannot_play "You can't play that card now.\n"
+#define MESSAGE_cannot_pay "Not enough mana.\n"
+#define MESSAGE_invalid_stops "Invalid stops, use step names like upkeep,main1,main2.\n"
+#define MESSAGE_stops_set "Stops set."
+#define MESSAGE_yield_turn "Passing until end of turn."
+#define MESSAGE_actions "Actions: "
+#define MESSAGE_deck_corrections "Card names corrected: "
@@ -0,0 +1,115 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <nlohmann/json.hpp>
+#include "Command.hpp"
+
+/*
+  Wire format of a Command sent from the client to the server.
+  Every message on the socket is still prefixed by its length
+  (4 bytes, network order). The payload is a fixed 12 bytes header
+  followed by the length-delimited fields:
+
+    offset  size  field
+    0       1     PROTOCOL_MAGIC | PROTOCOL_VERSION
+    1       1     opcode (CommandCode)
+    2       2     reserved, always 0
+    4       4     target length (network order)
+    8       4     extra length (network order)
+    12      ...   target bytes, then extra bytes
+
+  The first byte always has the high bit set, while a JSON message
+  always starts with '{', so the receiver can tell them apart.
+  JSON is kept as a debug fallback: compile the client with
+  -DPSIM_JSON_PROTOCOL to send human readable commands.
+*/
+
+#define PROTOCOL_MAGIC 0x80
+#define PROTOCOL_VERSION 1
+#define PROTOCOL_HEADER_SIZE 12
+
+inline void put_u32(std::string& out, uint32_t v) {
+  out.push_back(static_cast<char>((v >> 24) & 0xFF));
+  out.push_back(static_cast<char>((v >> 16) & 0xFF));
+  out.push_back(static_cast<char>((v >> 8) & 0xFF));
+  out.push_back(static_cast<char>(v & 0xFF));
+}
+
+inline uint32_t get_u32(const char* p) {
+  const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+  return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) |
+         (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+}
+
+inline bool is_binary_command(const char* data, size_t len) {
+  return len > 0 && (static_cast<unsigned char>(data[0]) & PROTOCOL_MAGIC);
+}
+
+inline void encode_command(const Command& command, std::string& out) {
+  // Appends the binary payload of the command to out.
+  out.reserve(out.size() + PROTOCOL_HEADER_SIZE + command.target.size() + command.extra.size());
+  out.push_back(static_cast<char>(PROTOCOL_MAGIC | PROTOCOL_VERSION));
+  out.push_back(static_cast<char>(command.code));
+  out.push_back(0);
+  out.push_back(0);
+  put_u32(out, static_cast<uint32_t>(command.target.size()));
+  put_u32(out, static_cast<uint32_t>(command.extra.size()));
+  out.append(command.target);
+  out.append(command.extra);
+}
+
+inline std::string encode_command_json(const Command& command) {
+  nlohmann::json j;
+  to_json(j, command);
+  return j.dump();
+}
+
+inline bool decode_binary_command(const char* data, size_t len, Command& command) {
+  if (len < PROTOCOL_HEADER_SIZE) return false;
+  unsigned char version = static_cast<unsigned char>(data[0]) & ~PROTOCOL_MAGIC;
+  if (version != PROTOCOL_VERSION) return false;
+  unsigned char opcode = static_cast<unsigned char>(data[1]);
+  uint32_t target_len = get_u32(data + 4);
+  uint32_t extra_len = get_u32(data + 8);
+  // compared as 64 bit values so that a forged length can't overflow.
+  if (uint64_t(PROTOCOL_HEADER_SIZE) + target_len + extra_len != len) return false;
+  command.code = commandCodeFromOpcode(opcode);
+  const char* fields = data + PROTOCOL_HEADER_SIZE;
+  command.target.assign(fields, target_len);
+  command.extra.assign(fields + target_len, extra_len);
+  return true;
+}
+
+inline bool decode_command(const char* data, size_t len, Command& command) {
+  /*
+    Decodes a payload in either format.
+    Returns false if the message is malformed.
+  */
+  if (is_binary_command(data, len)) {
+    return decode_binary_command(data, len, command);
+  }
+  try {
+    nlohmann::json j = nlohmann::json::parse(data, data + len);
+    from_json(j, command);
+    return true;
+  } catch (const nlohmann::json::exception&) {
+    return false;
+  }
+}
+
+inline std::string make_command_frame(const Command& command) {
+  // Length prefix and payload, ready to be written with a single call.
+  std::string frame(4, '\0');
+#ifdef PSIM_JSON_PROTOCOL
+  frame.append(encode_command_json(command));
+#else
+  encode_command(command, frame);
+#endif
+  uint32_t len = static_cast<uint32_t>(frame.size() - 4);
+  frame[0] = static_cast<char>((len >> 24) & 0xFF);
+  frame[1] = static_cast<char>((len >> 16) & 0xFF);
+  frame[2] = static_cast<char>((len >> 8) & 0xFF);
+  frame[3] = static_cast<char>(len & 0xFF);
+  return frame;
+}
@@ -5,7 +5,6 @@
 struct PublicInfo {
     unsigned turn;  // playerID
     unsigned priority; // playerID
-    unsigned card_id; // currently available card_id
     std::pair<int, int> life_points; // both player life points 
 };
 
@@ -6,6 +6,20 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include "Log.hpp"
+#include "CardNameMatcher.hpp"
+#include "ImageDownloader.hpp"
+
+#define SCRYFALL_RECORD_CACHE 1024 // CardRecords kept in memory
+#define SCRYFALL_REQUESTS_PER_SECOND 10 // API rate asked by Scryfall (50-100 ms between requests)
+#define SCRYFALL_REQUESTS_BURST 2
+#define SCRYFALL_COLLECTION_BATCH 75 // identifiers per /cards/collection request, the API maximum
+#define SCRYFALL_RETRIES 4 // of a request answered 429 Too Many Requests
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
@@ -16,18 +30,169 @@ namespace fs = std::filesystem;
   in JSON format with local caching support.
 */
 
+// The fields of a Scryfall card object the client uses.
+struct CardRecord {
+  bool valid = false; // false for an error answer, or not a card
+  std::string name;
+  std::string type_line;
+  int cmc = 0;
+  std::string image_url; // png, of the front face for double faced cards
+};
+
+class CardRecordReader : public nlohmann::json_sax<json> {
+  /*
+    Fills a CardRecord in one pass over the JSON text, without building
+    the document: the other fields of the card (prices, rulings, all
+    the printings links...) are skipped as they're read.
+  */
+public:
+  explicit CardRecordReader(CardRecord& record) : record(record) {}
+
+  std::string card_png;
+  std::string face_png; // double faced cards have no image of the card, only of the faces
+
+  bool null() override { return true; }
+  bool boolean(bool) override { return true; }
+  bool number_integer(number_integer_t value) override { return number(static_cast<double>(value)); }
+  bool number_unsigned(number_unsigned_t value) override { return number(static_cast<double>(value)); }
+  bool number_float(number_float_t value, const string_t&) override { return number(value); }
+  bool binary(binary_t&) override { return true; }
+
+  bool string(string_t& value) override {
+    if (depth == 1) {
+      if (field == "object") record.valid = value == "card";
+      else if (field == "name") record.name = std::move(value);
+      else if (field == "type_line") record.type_line = std::move(value);
+    } else if (field == "png" && in_images) {
+      (depth == 2 ? card_png : face_png) = std::move(value);
+    }
+    return true;
+  }
+
+  bool start_object(std::size_t) override {
+    depth++;
+    if (field == "image_uris" && (depth == 2 || (depth == 4 && in_faces && face == 0))) {
+      in_images = true;
+      images_depth = depth;
+    }
+    field.clear();
+    return true;
+  }
+
+  bool key(string_t& value) override {
+    field = std::move(value);
+    return true;
+  }
+
+  bool end_object() override {
+    if (in_images && depth == images_depth) in_images = false;
+    if (in_faces && depth == 3) face++;
+    depth--;
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    depth++;
+    if (depth == 2 && field == "card_faces") in_faces = true;
+    field.clear();
+    return true;
+  }
+
+  bool end_array() override {
+    if (depth == 2) in_faces = false;
+    depth--;
+    return true;
+  }
+
+  bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override {
+    return false;
+  }
+
+private:
+  bool number(double value) {
+    if (depth == 1 && field == "cmc") record.cmc = static_cast<int>(value);
+    return true;
+  }
+
+  CardRecord& record;
+  std::string field; // key of the value being read
+  int depth = 0; // 1 inside the card object
+  bool in_images = false;
+  int images_depth = 0;
+  bool in_faces = false;
+  int face = 0; // index in card_faces
+};
+
+inline CardRecord parseCardRecord(const std::string& jsonString) {
+  CardRecord record;
+  CardRecordReader reader(record);
+  if (!json::sax_parse(jsonString, &reader)) record.valid = false;
+  record.image_url = reader.face_png.empty() ? std::move(reader.card_png) : std::move(reader.face_png);
+  return record;
+}
+
+class TokenBucket {
+  /*
+    Spaces the requests to the API: up to burst requests at once, then
+    one every 1 / rate seconds. acquire() sleeps until a request may be
+    sent; pause() holds every request back, e.g. after a 429 answer.
+  */
+public:
+  using Clock = std::chrono::steady_clock;
+
+  TokenBucket(double rate, double burst) : rate(rate), burst(burst), tokens(burst), last(Clock::now()) {}
+
+  void acquire() {
+    while (true) {
+      Clock::time_point now = Clock::now();
+      if (now < paused_until) {
+        std::this_thread::sleep_until(paused_until);
+        continue;
+      }
+      tokens = std::min(burst, tokens + std::chrono::duration<double>(now - last).count() * rate);
+      last = now;
+      if (tokens >= 1) {
+        tokens -= 1;
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::duration<double>((1 - tokens) / rate));
+    }
+  }
+
+  void pause(std::chrono::milliseconds delay) {
+    paused_until = std::max(paused_until, Clock::now() + delay);
+    tokens = 0;
+  }
+
+private:
+  double rate; // tokens per second
+  double burst; // bucket size
+  double tokens;
+  Clock::time_point last;
+  Clock::time_point paused_until;
+};
+
 class ScryfallAPI {
 private:
     CURL* curlJson;
-    CURL* curlImage;
+    ImageDownloader downloader; // images, several at once
     std::string baseUrl = "https://api.scryfall.com";
     std::string cacheDir = "data";
     std::string jsonDir;
     std::string imageDir;
+    // Least recently used CardRecords, by normalized name.
+    std::list<std::pair<std::string, CardRecord>> recordOrder;
+    std::unordered_map<std::string, std::list<std::pair<std::string, CardRecord>>::iterator> records;
+    TokenBucket limiter{SCRYFALL_REQUESTS_PER_SECOND, SCRYFALL_REQUESTS_BURST};
 
 public:
-    ScryfallAPI() {
+    // downloads: images fetched at once, 0 for PSIM_SCRYFALL_DOWNLOADS
+    // or else IMAGE_DOWNLOADS.
+    explicit ScryfallAPI(size_t downloads = 0) : downloader(downloads ? downloads : defaultDownloads()) {
         curl_global_init(CURL_GLOBAL_DEFAULT);
+        // PSIM_SCRYFALL_URL points the client to another server, e.g. a
+        // local stand-in of the API for tests.
+        if (const char* url = std::getenv("PSIM_SCRYFALL_URL")) baseUrl = url;
 
         // Setup cache directories
         jsonDir = cacheDir + "/json";
@@ -37,9 +202,9 @@ public:
         try {
             fs::create_directories(jsonDir);
             fs::create_directories(imageDir);
-            std::cout << "Cache directories initialized: " << cacheDir << std::endl;
+            LOG_DEBUG(Scryfall, "Cache directories initialized: ", cacheDir);
         } catch (const fs::filesystem_error& e) {
-            std::cerr << "Error creating cache directories: " << e.what() << std::endl;
+            LOG_ERROR(Scryfall, "Error creating cache directories: ", e.what());
         }
 
         // JSON handle
@@ -48,21 +213,22 @@ public:
             curl_easy_setopt(curlJson, CURLOPT_FOLLOWLOCATION, 1L);
             curl_easy_setopt(curlJson, CURLOPT_USERAGENT, "ScryfallCppClient/1.0");
         }
-
-        // Image handle
-        curlImage = curl_easy_init();
-        if (curlImage) {
-            curl_easy_setopt(curlImage, CURLOPT_FOLLOWLOCATION, 1L);
-            curl_easy_setopt(curlImage, CURLOPT_USERAGENT, "ScryfallCppClient/1.0");
-        }
     }
 
     ~ScryfallAPI() {
         if (curlJson)  curl_easy_cleanup(curlJson);
-        if (curlImage) curl_easy_cleanup(curlImage);
         curl_global_cleanup();
     }
 
+    static size_t defaultDownloads() {
+        if (const char* value = std::getenv("PSIM_SCRYFALL_DOWNLOADS")) {
+            long downloads = std::strtol(value, nullptr, 10);
+            if (downloads > 0) return static_cast<size_t>(downloads);
+            LOG_WARN(Scryfall, "Ignoring PSIM_SCRYFALL_DOWNLOADS=", value);
+        }
+        return IMAGE_DOWNLOADS;
+    }
+
     static size_t WriteStringCallback(void* contents, size_t size, size_t nmemb, void* userp) {
         size_t totalSize = size * nmemb;
         std::string* str = static_cast<std::string*>(userp);
@@ -70,15 +236,6 @@ public:
         return totalSize;
     }
 
-    static size_t WriteVectorCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-        size_t totalSize = size * nmemb;
-        auto* buffer = static_cast<std::vector<unsigned char>*>(userp);
-        buffer->insert(buffer->end(),
-                       (unsigned char*)contents,
-                       (unsigned char*)contents + totalSize);
-        return totalSize;
-    }
-
     // Helper function to sanitize filename
     std::string sanitizeFilename(const std::string& name) {
         std::string sanitized = name;
@@ -118,7 +275,7 @@ public:
 
         std::stringstream buffer;
         buffer << file.rdbuf();
-        std::cout << "Loaded JSON from cache: " << cacheKey << std::endl;
+        LOG_DEBUG(Scryfall, "Loaded JSON from cache: ", cacheKey);
         return buffer.str();
     }
 
@@ -129,9 +286,9 @@ public:
         std::ofstream file(filepath);
         if (file.is_open()) {
             file << jsonData;
-            std::cout << "Saved JSON to cache: " << cacheKey << std::endl;
+            LOG_DEBUG(Scryfall, "Saved JSON to cache: ", cacheKey);
         } else {
-            std::cerr << "Failed to save JSON to cache: " << filepath << std::endl;
+            LOG_ERROR(Scryfall, "Failed to save JSON to cache: ", filepath);
         }
     }
 
@@ -158,7 +315,7 @@ public:
         buffer.resize(size);
         file.read(reinterpret_cast<char*>(buffer.data()), size);
         
-        std::cout << "Loaded image from cache: " << cacheKey << std::endl;
+        LOG_DEBUG(Scryfall, "Loaded image from cache: ", cacheKey);
         return buffer;
     }
 
@@ -169,32 +326,61 @@ public:
         std::ofstream file(filepath, std::ios::binary);
         if (file.is_open()) {
             file.write(reinterpret_cast<const char*>(imageData.data()), imageData.size());
-            std::cout << "Saved image to cache: " << cacheKey << std::endl;
+            LOG_DEBUG(Scryfall, "Saved image to cache: ", cacheKey);
         } else {
-            std::cerr << "Failed to save image to cache: " << filepath << std::endl;
+            LOG_ERROR(Scryfall, "Failed to save image to cache: ", filepath);
         }
     }
 
-    std::string makeRequest(const std::string& endpoint) {
+    void setBaseUrl(const std::string& url) { baseUrl = url; }
+
+    // GET, or POST of a JSON body when there is one. Requests go
+    // through the rate limiter; a 429 answer pauses all of them for the
+    // Retry-After of the server, or an exponential backoff, and the
+    // request is sent again.
+    std::string makeRequest(const std::string& endpoint, const std::string* body = nullptr) {
         if (!curlJson) {
             return "Error: CURL initialization failed";
         }
 
         std::string response;
         std::string url = baseUrl + endpoint;
-        std::cout<<url<<std::endl;
+        struct curl_slist* headers = nullptr;
+        if (body) headers = curl_slist_append(headers, "Content-Type: application/json");
 
         curl_easy_setopt(curlJson, CURLOPT_URL, url.c_str());
         curl_easy_setopt(curlJson, CURLOPT_WRITEFUNCTION, WriteStringCallback);
         curl_easy_setopt(curlJson, CURLOPT_WRITEDATA, &response);
-
-        CURLcode res = curl_easy_perform(curlJson);
+        curl_easy_setopt(curlJson, CURLOPT_HTTPHEADER, headers);
+        if (body) {
+            curl_easy_setopt(curlJson, CURLOPT_POSTFIELDS, body->c_str());
+            curl_easy_setopt(curlJson, CURLOPT_POSTFIELDSIZE, static_cast<long>(body->size()));
+        } else {
+            curl_easy_setopt(curlJson, CURLOPT_HTTPGET, 1L);
+        }
+
+        CURLcode res = CURLE_OK;
+        long responseCode = 0;
+        for (int attempt = 0; attempt <= SCRYFALL_RETRIES; attempt++) {
+            limiter.acquire();
+            LOG_DEBUG(Scryfall, body ? "POST " : "GET ", url);
+            response.clear();
+            res = curl_easy_perform(curlJson);
+            if (res != CURLE_OK) break;
+            curl_easy_getinfo(curlJson, CURLINFO_RESPONSE_CODE, &responseCode);
+            if (responseCode != 429 || attempt == SCRYFALL_RETRIES) break;
+            curl_off_t retryAfter = 0;
+            curl_easy_getinfo(curlJson, CURLINFO_RETRY_AFTER, &retryAfter);
+            std::chrono::milliseconds delay = retryAfter > 0 ? std::chrono::milliseconds(retryAfter * 1000)
+                                                             : std::chrono::milliseconds(500 << attempt);
+            LOG_WARN(Scryfall, "429 from ", url, ", retrying in ", delay.count(), " ms");
+            limiter.pause(delay);
+        }
+        curl_easy_setopt(curlJson, CURLOPT_HTTPHEADER, nullptr);
+        curl_slist_free_all(headers);
         if (res != CURLE_OK) {
             return "Error: " + std::string(curl_easy_strerror(res));
         }
-
-        long responseCode;
-        curl_easy_getinfo(curlJson, CURLINFO_RESPONSE_CODE, &responseCode);
         if (responseCode != 200) {
             return "HTTP Error: " + std::to_string(responseCode) + "\n" + response;
         }
@@ -203,21 +389,7 @@ public:
     }
 
     std::vector<unsigned char> downloadImage(const std::string& url) {
-        std::vector<unsigned char> buffer;
-
-        if (!curlImage) return buffer;
-
-        curl_easy_setopt(curlImage, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curlImage, CURLOPT_WRITEFUNCTION, WriteVectorCallback);
-        curl_easy_setopt(curlImage, CURLOPT_WRITEDATA, &buffer);
-
-        CURLcode res = curl_easy_perform(curlImage);
-        if (res != CURLE_OK) {
-            std::cerr << "curl_easy_perform() failed: "
-                      << curl_easy_strerror(res) << "\n";
-        }
-
-        return buffer;
+        return downloader.fetch(url);
     }
 
     std::string urlEncode(const std::string& value) {
@@ -285,7 +457,7 @@ public:
                     saveJsonToCache(idCacheKey, response);
                 }
             } catch (const json::exception& e) {
-                std::cerr << "Error parsing JSON for caching: " << e.what() << std::endl;
+                LOG_WARN(Scryfall, "Error parsing JSON for caching: ", e.what());
             }
         }
         
@@ -363,49 +535,138 @@ public:
         return imageData;
     }
 
+    // Many images at once through the downloader: next and done as in
+    // ImageDownloader::run. Images in the cache are given to done right
+    // away, the others once downloaded, and saved.
+    template <typename Next, typename Done>
+    void downloadImagesCached(Next next, Done done) {
+        std::unordered_map<size_t, std::string> keys; // cache keys of the images in flight, by id
+        downloader.run(
+            [&](ImageDownload& download) {
+                while (next(download)) {
+                    std::string cacheKey = download.url.empty() ? "" : generateCacheKey(download.url);
+                    std::vector<unsigned char> cachedImage;
+                    if (!cacheKey.empty()) cachedImage = loadImageFromCache(cacheKey);
+                    if (cacheKey.empty() || !cachedImage.empty()) {
+                        done(download.id, std::move(cachedImage));
+                        continue;
+                    }
+                    keys[download.id] = std::move(cacheKey);
+                    return true;
+                }
+                return false;
+            },
+            [&](size_t id, std::vector<unsigned char>&& imageData) {
+                if (!imageData.empty()) saveImageToCache(keys[id], imageData);
+                keys.erase(id);
+                done(id, std::move(imageData));
+            });
+    }
+
     // Updated helper methods that work with cached data
 
     std::string getCardImageURL(const std::string& jsonString) {
-        auto j = json::parse(jsonString);
+        return parseCardRecord(jsonString).image_url;
+    }
 
-        // Handle double-faced / modal cards
-        if (j.contains("card_faces") && j["card_faces"].is_array() && !j["card_faces"].empty()) {
-            const auto& frontFace = j["card_faces"][0];
-            if (frontFace.contains("image_uris") && frontFace["image_uris"].contains("png")) {
-                return frontFace["image_uris"]["png"].get<std::string>();
-            }
-        }
+    std::string getCardName(const std::string& jsonString) {
+        return parseCardRecord(jsonString).name;
+    }
 
-        // Handle single-faced cards
-        if (j.contains("image_uris") && j["image_uris"].contains("png")) {
-            return j["image_uris"]["png"].get<std::string>();
-        }
+    unsigned getCardCmc(const std::string& jsonString) {
+        return parseCardRecord(jsonString).cmc;
+    }
 
-        return "";
+     std::string getCardType(const std::string& jsonString) {
+        return parseCardRecord(jsonString).type_line;
     }
 
-    std::string getCardName(const std::string& jsonString) {
-        auto j = json::parse(jsonString);
-        if (j.contains("name")) {
-            return j["name"].get<std::string>();
-        }
-        return "";
+    // Card by name as a CardRecord, parsed once and kept in memory:
+    // a deck with 4 copies of a card reads its JSON a single time.
+    CardRecord getCardRecord(const std::string& rawCardName) {
+        std::string key = normalizeCardName(rawCardName);
+        auto it = records.find(key);
+        if (it != records.end()) {
+            recordOrder.splice(recordOrder.begin(), recordOrder, it->second);
+            return it->second->second;
+        }
+        CardRecord record = parseCardRecord(getCardByName(rawCardName));
+        if (record.valid) keepRecord(key, record); // network errors are not kept
+        return record;
     }
 
-    unsigned getCardCmc(const std::string& jsonString) {
-        auto j = json::parse(jsonString);
-        if (j.contains("cmc")) {
-            return j["cmc"].get<int>();
+    // Resolves the cards of a whole deck up front: the names found in
+    // neither cache are asked by batches of SCRYFALL_COLLECTION_BATCH to
+    // /cards/collection, so a cold deck costs one or two requests
+    // instead of one per card. Names the collection doesn't know
+    // (collection names must be exact) are left to getCardRecord, which
+    // asks the fuzzy /cards/named.
+    void prefetchCardRecords(const std::vector<std::string>& rawCardNames) {
+        std::vector<std::string> missing;
+        std::unordered_map<std::string, std::string> wanted; // normalized name -> trimmed name
+        for (const std::string& rawCardName : rawCardNames) {
+            std::string cardName = trim(rawCardName);
+            std::string key = normalizeCardName(cardName);
+            if (key.empty() || records.count(key) || wanted.count(key)) continue;
+            std::string cached = loadJsonFromCache(generateCacheKey("name_" + cardName));
+            if (!cached.empty()) {
+                CardRecord record = parseCardRecord(cached);
+                if (record.valid) {
+                    keepRecord(key, record);
+                    continue;
+                }
+            }
+            wanted.emplace(key, cardName);
+            missing.push_back(cardName);
+        }
+        for (size_t begin = 0; begin < missing.size(); begin += SCRYFALL_COLLECTION_BATCH) {
+            size_t end = std::min(missing.size(), begin + SCRYFALL_COLLECTION_BATCH);
+            json identifiers = json::array();
+            for (size_t i = begin; i < end; i++) identifiers.push_back({{"name", missing[i]}});
+            std::string body = json{{"identifiers", std::move(identifiers)}}.dump();
+            std::string response = makeRequest("/cards/collection", &body);
+            if (response.find("Error:") == 0 || response.find("HTTP Error:") == 0) {
+                LOG_WARN(Scryfall, "collection request failed: ", response.substr(0, 200));
+                continue;
+            }
+            size_t found = 0;
+            try {
+                json list = json::parse(response);
+                if (!list.contains("data") || !list["data"].is_array()) continue;
+                for (const json& card : list["data"]) {
+                    // The answer holds the cards, not the names asked:
+                    // split cards asked by their front face come back
+                    // with their full name.
+                    std::string raw = card.dump();
+                    CardRecord record = parseCardRecord(raw);
+                    if (!record.valid) continue;
+                    std::string key = normalizeCardName(record.name);
+                    auto asked = wanted.find(key);
+                    size_t faces = record.name.find("//");
+                    if (asked == wanted.end() && faces != std::string::npos) {
+                        key = normalizeCardName(record.name.substr(0, faces));
+                        asked = wanted.find(key);
+                    }
+                    if (asked == wanted.end()) continue;
+                    saveJsonToCache(generateCacheKey("name_" + asked->second), raw);
+                    keepRecord(key, record);
+                    wanted.erase(asked);
+                    found++;
+                }
+            } catch (const json::exception& e) {
+                LOG_WARN(Scryfall, "Error parsing collection answer: ", e.what());
+            }
+            LOG_DEBUG(Scryfall, "collection: ", found, "/", end - begin, " cards found");
         }
-        return 0;
     }
 
-     std::string getCardType(const std::string& jsonString) {
-        auto j = json::parse(jsonString);
-        if (j.contains("type_line")) {
-            return j["type_line"].get<std::string>();
+    void keepRecord(const std::string& key, const CardRecord& record) {
+        recordOrder.emplace_front(key, record);
+        records[key] = recordOrder.begin();
+        if (records.size() > SCRYFALL_RECORD_CACHE) {
+            records.erase(recordOrder.back().first);
+            recordOrder.pop_back();
         }
-        return "";
     }
 
     // Utility methods for cache management
@@ -414,9 +675,9 @@ public:
             fs::remove_all(cacheDir);
             fs::create_directories(jsonDir);
             fs::create_directories(imageDir);
-            std::cout << "Cache cleared successfully." << std::endl;
+            LOG_INFO(Scryfall, "Cache cleared successfully.");
         } catch (const fs::filesystem_error& e) {
-            std::cerr << "Error clearing cache: " << e.what() << std::endl;
+            LOG_ERROR(Scryfall, "Error clearing cache: ", e.what());
         }
     }
 
@@ -429,7 +690,7 @@ public:
                 }
             }
         } catch (const fs::filesystem_error& e) {
-            std::cerr << "Error calculating cache size: " << e.what() << std::endl;
+            LOG_ERROR(Scryfall, "Error calculating cache size: ", e.what());
         }
         return totalSize;
     }
@@ -445,7 +706,7 @@ public:
                 if (entry.is_regular_file()) imageCount++;
             }
         } catch (const fs::filesystem_error& e) {
-            std::cerr << "Error reading cache stats: " << e.what() << std::endl;
+            LOG_ERROR(Scryfall, "Error reading cache stats: ", e.what());
         }
 
         std::cout << "Cache Statistics:" << std::endl;
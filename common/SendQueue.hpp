@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <boost/asio.hpp>
+#include "Framing.hpp"
+
+/*
+  Outgoing frames of one connection.
+  asio allows a single write in flight per socket, so frames are
+  queued here and the owner keeps at most one async_write running:
+  when it completes, everything that was queued meanwhile is sent with
+  a single gathered write (one syscall for a burst of messages).
+  Frames are shared and immutable (see Framing.hpp), the queue only
+  holds references to them.
+  The queue does no I/O and no locking, it must be used from the
+  strand that owns the socket.
+*/
+class SendQueue {
+public:
+  SendQueue() : writing(false) {}
+
+  void push(SharedFrame frame) {
+    pending.push_back(std::move(frame));
+  }
+
+  bool start() {
+    /*
+      Moves the pending frames in flight. Returns true if the caller
+      has to issue a write with buffers(), false if a write is already
+      running or there is nothing to send.
+    */
+    if (writing || pending.empty()) return false;
+    in_flight.swap(pending);
+    gather.clear();
+    for (auto& frame : in_flight) {
+      gather.push_back(boost::asio::buffer(*frame));
+    }
+    writing = true;
+    return true;
+  }
+
+  const std::vector<boost::asio::const_buffer>& buffers() const { return gather; }
+
+  size_t done() {
+    // Called when the write issued after start() completed.
+    // Returns how many frames have been written.
+    size_t written = in_flight.size();
+    in_flight.clear();
+    gather.clear();
+    writing = false;
+    return written;
+  }
+
+  size_t clear() {
+    // Drops the frames not sent yet, returns how many.
+    size_t dropped = pending.size();
+    pending.clear();
+    return dropped;
+  }
+
+  size_t trim(size_t limit) {
+    // Keeps at most limit frames waiting, dropping the oldest ones.
+    // For receivers that only care about the latest state.
+    if (pending.size() <= limit) return 0;
+    size_t dropped = pending.size() - limit;
+    pending.erase(pending.begin(), pending.begin() + dropped);
+    return dropped;
+  }
+
+  size_t depth() const { return pending.size() + in_flight.size(); }
+
+private:
+  std::vector<SharedFrame> pending;
+  std::vector<SharedFrame> in_flight;
+  std::vector<boost::asio::const_buffer> gather;
+  bool writing;
+};
@@ -34,7 +34,7 @@ void display_cards(const std::vector<Card>& hand) {
 
     // Print title line
     for (const auto& card : hand) {
-        std::cout << "|" << fitString(card.title, width - 2) << "|  ";
+        std::cout << "|" << fitString(card.title(), width - 2) << "|  ";
     }
     std::cout << "\n";
 
@@ -46,7 +46,7 @@ void display_cards(const std::vector<Card>& hand) {
 
     // Print effect line (trimmed)
     for (const auto& card : hand) {
-        std::cout << "|" << fitString(card.effect, width - 2) << "|  ";
+        std::cout << "|" << fitString(card.effect(), width - 2) << "|  ";
     }
     std::cout << "\n";
 
@@ -0,0 +1,243 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <nlohmann/json.hpp>
+#include "CardIndex.hpp"
+
+/*
+  Builds the binary card database (CardIndex.hpp) from a Scryfall bulk
+  export, e.g. the "Oracle Cards" or "Default Cards" file from
+  https://scryfall.com/docs/api/bulk-data saved locally.
+  The export is a JSON array of several hundred MB: it's read with the
+  SAX interface of nlohmann::json, keeping only the fields of the card
+  being read, so memory stays at the size of the output. Tokens, art
+  cards and emblems are skipped; when a card has several printings the
+  first one in the file is kept.
+
+  Usage: ./ingest_app [--out data/cards.bin] [--check] BULK.json
+  --check opens the written file and looks every card up by name.
+*/
+
+class BulkCardReader : public nlohmann::json_sax<nlohmann::json> {
+public:
+  explicit BulkCardReader(CardIndexWriter& writer) : writer(writer) {}
+
+  size_t read = 0; // card objects in the export
+  size_t skipped = 0; // not a playable card, or a later printing
+  std::string error;
+
+  bool null() override { return true; }
+  bool boolean(bool) override { return true; }
+  bool number_integer(number_integer_t value) override { return number(static_cast<double>(value)); }
+  bool number_unsigned(number_unsigned_t value) override { return number(static_cast<double>(value)); }
+  bool number_float(number_float_t value, const string_t&) override { return number(value); }
+  bool binary(binary_t&) override { return true; }
+
+  bool string(string_t& value) override {
+    const std::string& field = current_key();
+    switch (frames.size()) {
+      case 2: // card
+        if (field == "object") object = value;
+        else if (field == "layout") layout = value;
+        else if (field == "name") card.name = std::move(value);
+        else if (field == "oracle_id") card.oracle_id = std::move(value);
+        else if (field == "type_line") card.type_line = std::move(value);
+        else if (field == "mana_cost") card.mana_cost = std::move(value);
+        else if (field == "oracle_text") card.oracle_text = std::move(value);
+        break;
+      case 3:
+        if (frames[2].key == "colors") card.colors |= cardColorFromString(value);
+        else if (frames[2].key == "legalities") legality(field, value);
+        else if (frames[2].key == "image_uris") image(card.images, field, value);
+        break;
+      case 4: // face of a multi faced card
+        if (frames[2].key != "card_faces") break;
+        if (field == "mana_cost" && face_mana_cost.empty()) face_mana_cost = std::move(value);
+        else if (field == "oracle_text") {
+          if (!face_oracle_text.empty()) face_oracle_text += "\n//\n";
+          face_oracle_text += value;
+        }
+        break;
+      case 5:
+        if (frames[2].key == "card_faces" && frames[4].key == "image_uris" && frames[2].index == 0) {
+          image(face_images, field, value);
+        }
+        break;
+    }
+    advance();
+    return true;
+  }
+
+  bool start_object(std::size_t) override {
+    if (frames.empty()) {
+      error = "the export must be an array of cards";
+      return false;
+    }
+    if (frames.size() == 1) begin_card();
+    open(false);
+    return true;
+  }
+
+  bool key(string_t& value) override {
+    frames.back().pending_key = std::move(value);
+    return true;
+  }
+
+  bool end_object() override {
+    close();
+    if (frames.size() == 1) end_card();
+    advance();
+    return true;
+  }
+
+  bool start_array(std::size_t) override {
+    open(true);
+    return true;
+  }
+
+  bool end_array() override {
+    close();
+    advance();
+    return true;
+  }
+
+  bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+    error = "byte " + std::to_string(position) + ": " + e.what();
+    return false;
+  }
+
+private:
+  struct Frame {
+    bool array;
+    std::string key; // under which the parent holds this container
+    std::string pending_key; // objects: key of the next value
+    size_t index = 0; // arrays: values seen so far
+  };
+
+  const std::string& current_key() const {
+    static const std::string none;
+    return frames.empty() || frames.back().array ? none : frames.back().pending_key;
+  }
+
+  void open(bool array) {
+    Frame frame{array, current_key(), "", 0};
+    frames.push_back(std::move(frame));
+  }
+
+  void close() { frames.pop_back(); }
+
+  void advance() {
+    if (!frames.empty() && frames.back().array) frames.back().index++;
+  }
+
+  bool number(double value) {
+    if (frames.size() == 2 && current_key() == "cmc") card.cmc = static_cast<float>(value);
+    advance();
+    return true;
+  }
+
+  void legality(const std::string& format, const std::string& status) {
+    int i = cardFormatIndex(format);
+    if (i >= 0) card.legalities[static_cast<size_t>(i)] = cardLegalityFromString(status);
+  }
+
+  static void image(std::array<std::string, CARD_INDEX_IMAGES>& images, const std::string& size, std::string& url) {
+    if (size == "png") images[0] = std::move(url);
+    else if (size == "normal") images[1] = std::move(url);
+    else if (size == "small") images[2] = std::move(url);
+  }
+
+  void begin_card() {
+    card = CardIndexEntry();
+    object.clear();
+    layout.clear();
+    face_mana_cost.clear();
+    face_oracle_text.clear();
+    face_images = {};
+  }
+
+  void end_card() {
+    // Multi faced cards keep these on their faces: take the front one.
+    read++;
+    if (object != "card" || layout == "token" || layout == "double_faced_token" || layout == "emblem" ||
+        layout == "art_series") {
+      skipped++;
+      return;
+    }
+    if (card.mana_cost.empty()) card.mana_cost = std::move(face_mana_cost);
+    if (card.oracle_text.empty()) card.oracle_text = std::move(face_oracle_text);
+    if (card.images[0].empty()) card.images = std::move(face_images);
+    if (!writer.add(std::move(card))) skipped++;
+  }
+
+  CardIndexWriter& writer;
+  std::vector<Frame> frames;
+  CardIndexEntry card;
+  std::string object;
+  std::string layout;
+  std::string face_mana_cost;
+  std::string face_oracle_text;
+  std::array<std::string, CARD_INDEX_IMAGES> face_images;
+};
+
+bool check(const std::string& path) {
+  // Every card must be found by its own name.
+  CardIndex index;
+  if (!index.open(path)) {
+    std::cerr << path << ": not a valid card index\n";
+    return false;
+  }
+  std::vector<std::string> names;
+  names.reserve(index.size());
+  for (uint32_t i = 0; i < index.size(); i++) names.emplace_back(index.string(index.record(i).name));
+  auto begin = std::chrono::steady_clock::now();
+  size_t found = 0;
+  for (const std::string& name : names) found += index.find(name) != nullptr;
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  std::cout << "check: " << found << "/" << names.size() << " names found, " << std::fixed
+            << std::setprecision(3) << (names.empty() ? 0 : seconds * 1e6 / names.size()) << " us per lookup\n";
+  return found == names.size();
+}
+
+int main(int argc, char* argv[]) {
+  std::string out = CARD_INDEX_FILE;
+  std::string bulk;
+  bool verify = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--out" && i + 1 < argc) out = argv[++i];
+    else if (arg == "--check") verify = true;
+    else bulk = arg;
+  }
+  if (bulk.empty()) {
+    std::cerr << "Usage: ./ingest_app [--out data/cards.bin] [--check] BULK.json\n";
+    return 1;
+  }
+  FILE* file = std::fopen(bulk.c_str(), "rb");
+  if (!file) {
+    std::cerr << "Cannot open " << bulk << "\n";
+    return 1;
+  }
+  auto begin = std::chrono::steady_clock::now();
+  CardIndexWriter writer;
+  BulkCardReader reader(writer);
+  bool parsed = nlohmann::json::sax_parse(file, &reader);
+  std::fclose(file);
+  if (!parsed) {
+    std::cerr << bulk << ": " << (reader.error.empty() ? "invalid JSON" : reader.error) << "\n";
+    return 1;
+  }
+  std::string error;
+  if (!writer.write(out, error)) {
+    std::cerr << error << "\n";
+    return 1;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  std::cout << writer.size() << " cards written to " << out << " (" << reader.read << " read, "
+            << reader.skipped << " skipped) in " << std::fixed << std::setprecision(2) << seconds << " s\n";
+  if (verify && !check(out)) return 1;
+  return 0;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include "CardDefinitions.hpp"
+#include "CardIndex.hpp"
+#include "CardNameMatcher.hpp"
+#include "Log.hpp"
+
+#define CARD_DATABASE_BULK_FILE "data/cards.json"
+#define CARD_DATABASE_CACHE_DIR "data/json"
+
+/*
+  Card data known to the server without going to the network.
+  Loaded once at startup from the binary database built by ingest_app
+  (CARD_INDEX_FILE, memory mapped, names are resolved through its hash
+  index) or, without it, from a Scryfall bulk export (an array of card
+  objects in CARD_DATABASE_BULK_FILE) parsed whole; then from the
+  single card answers cached by ScryfallAPI in CARD_DATABASE_CACHE_DIR.
+  resolve() also accepts names with typos, see CardNameMatcher.hpp.
+  The cards of the binary database stay in the mapped file until they
+  are first asked for: only then is their CardData built and their
+  definition interned in the CardDefinitions table, so startup costs
+  no more than mapping the file. The name matcher is built on the
+  first lookup that needs it. Both are safe for the deck validation
+  workers reading the database concurrently, nothing else changes
+  after loading. Validated decks only copy definition ids.
+*/
+
+struct CardData {
+  std::string name;
+  std::string type_line;
+  int cmc = 0;
+  bool any_number = false; // "A deck can have any number of cards named ..."
+  CardDefinitionId definition = 0;
+  std::array<CardLegality, CARD_INDEX_FORMATS> legalities{}; // by cardFormatIndex
+
+  CardLegality legality(const std::string& format) const {
+    int i = cardFormatIndex(format);
+    return i < 0 ? CardLegality::Unknown : legalities[static_cast<size_t>(i)];
+  }
+};
+
+class CardDatabase {
+public:
+  CardDatabase() = default;
+  CardDatabase(const CardDatabase&) = delete;
+  CardDatabase& operator=(const CardDatabase&) = delete;
+
+  ~CardDatabase() {
+    for (uint32_t i = 0; built && i < index.size(); i++) delete built[i].load(std::memory_order_relaxed);
+  }
+
+  void load(const std::string& bulk_file = CARD_DATABASE_BULK_FILE,
+            const std::string& cache_dir = CARD_DATABASE_CACHE_DIR,
+            const std::string& index_file = CARD_INDEX_FILE) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (index.open(index_file)) {
+      built.reset(new std::atomic<CardData*>[index.size()]());
+    } else if (fs::exists(bulk_file, ec)) {
+      try {
+        std::ifstream is(bulk_file);
+        nlohmann::json cards = nlohmann::json::parse(is);
+        for (auto& card : cards) add(card);
+      } catch (const nlohmann::json::exception& e) {
+        LOG_ERROR(Deck, "Invalid card database ", bulk_file, ": ", e.what());
+      }
+    }
+    if (fs::is_directory(cache_dir, ec)) {
+      for (const auto& entry : fs::directory_iterator(cache_dir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".json") continue;
+        try {
+          std::ifstream is(entry.path());
+          add(nlohmann::json::parse(is));
+        } catch (const nlohmann::json::exception&) {} // not a card, e.g. a search result
+      }
+    }
+  }
+
+  const CardData* find(const std::string& name) const {
+    if (const CardIndexRecord* record = index.find(name)) return indexed(index.position(record));
+    auto it = cards.find(key(name));
+    return it == cards.end() ? nullptr : &it->second;
+  }
+
+  const CardData* resolve(const std::string& name) const {
+    // find(), or the closest name if there is no exact match.
+    if (const CardData* card = find(name)) return card;
+    std::call_once(matcher_built, [this]() { build_matcher(); });
+    uint32_t i = matcher.match(name);
+    if (i == CardNameMatcher::npos) return nullptr;
+    return i < index.size() ? indexed(i) : listed[i - index.size()];
+  }
+
+  bool empty() const { return index.size() == 0 && cards.empty(); }
+  size_t size() const { return index.size() + cards.size(); }
+
+private:
+  static std::string key(const std::string& name) {
+    std::string k = name;
+    std::transform(k.begin(), k.end(), k.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return k;
+  }
+
+  void add(const nlohmann::json& j) {
+    if (!j.is_object() || j.value("object", "") != "card" || !j.contains("name")) return;
+    CardData card;
+    card.name = j["name"].get<std::string>();
+    card.type_line = j.value("type_line", "");
+    card.cmc = static_cast<int>(j.value("cmc", 0.0));
+    std::string oracle_text = j.value("oracle_text", "");
+    card.any_number = oracle_text.find("any number of cards named") != std::string::npos;
+    card.definition = CardDefinitions::instance().intern(card.name, oracle_text, card.type_line, card.cmc);
+    if (j.contains("legalities") && j["legalities"].is_object()) {
+      for (auto& [format, status] : j["legalities"].items()) {
+        int i = cardFormatIndex(format);
+        if (i >= 0) card.legalities[static_cast<size_t>(i)] = cardLegalityFromString(status.get<std::string>());
+      }
+    }
+    // Double faced cards are listed by their front face in decklists.
+    size_t faces = card.name.find(" // ");
+    if (faces != std::string::npos) {
+      cards.emplace(key(card.name.substr(0, faces)), card);
+    }
+    cards.emplace(key(card.name), std::move(card));
+  }
+
+  const CardData* indexed(uint32_t i) const {
+    // Built by the first worker asking for it; a worker losing the
+    // race drops its copy, interning gave it the same definition.
+    CardData* card = built[i].load(std::memory_order_acquire);
+    if (card) return card;
+    auto fresh = std::make_unique<CardData>(from_record(index.record(i)));
+    if (built[i].compare_exchange_strong(card, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+      return fresh.release();
+    }
+    return card;
+  }
+
+  void build_matcher() const {
+    // Ids below index.size() are records of the index, the others
+    // point into listed.
+    for (uint32_t i = 0; i < index.size(); i++) matcher.add(index.string(index.record(i).name), i);
+    for (const auto& [name, card] : cards) {
+      matcher.add(card.name, static_cast<uint32_t>(index.size() + listed.size()));
+      listed.push_back(&card);
+    }
+  }
+
+  CardData from_record(const CardIndexRecord& record) const {
+    CardData card;
+    card.name = index.string(record.name);
+    card.type_line = index.string(record.type_line);
+    card.cmc = static_cast<int>(record.cmc);
+    std::string oracle_text(index.string(record.oracle_text));
+    card.any_number = oracle_text.find("any number of cards named") != std::string::npos;
+    card.definition = CardDefinitions::instance().intern(card.name, oracle_text, card.type_line, card.cmc);
+    for (size_t i = 0; i < CARD_INDEX_FORMATS; i++) card.legalities[i] = static_cast<CardLegality>(record.legalities[i]);
+    return card;
+  }
+
+  CardIndex index;
+  std::unique_ptr<std::atomic<CardData*>[]> built; // by record of the index, null until asked for
+  std::unordered_map<std::string, CardData> cards; // bulk export and API cache, by lowercased name
+  mutable std::once_flag matcher_built;
+  mutable CardNameMatcher matcher;
+  mutable std::vector<const CardData*> listed; // cards of the map, by matcher id - index.size()
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <functional>
+#include <utility>
+#include <boost/asio.hpp>
+#include "Card.hpp"
+#include "CardDatabase.hpp"
+
+#define DECK_FORMAT "vintage"
+#define DECK_MIN_MAIN 60
+#define DECK_MAX_SIDEBOARD 15
+#define DECK_MAX_COPIES 4
+#define DECK_MAX_CARDS 250 // main and sideboard, checked before any card is made
+
+/*
+  Deck upload checks, run by a pool of worker threads so that parsing
+  big uploads never delays the games running on the io threads.
+  check_deck() turns the raw list into cards and checks it against
+  the card database and the rules of DECK_FORMAT; the match applies
+  the result on its own strand (see Game::accept_deck).
+*/
+
+struct DeckCheck {
+  bool valid = false;
+  std::string error;
+  std::vector<Card> main; // instance ids are assigned by the game
+  std::vector<Card> side;
+  std::vector<std::pair<std::string, std::string>> corrections; // misspelled name, card it was read as
+};
+
+inline bool is_basic_land(const std::string& name, const CardData* data) {
+  if (data) return data->type_line.find("Basic") != std::string::npos;
+  static const char* basics[] = {"Plains", "Island", "Swamp", "Mountain", "Forest", "Wastes",
+    "Snow-Covered Plains", "Snow-Covered Island", "Snow-Covered Swamp",
+    "Snow-Covered Mountain", "Snow-Covered Forest"};
+  for (const char* basic : basics) {
+    if (name == basic) return true;
+  }
+  return false;
+}
+
+inline DeckCheck check_deck(const std::string& raw_deck, const CardDatabase& db) {
+  /*
+    Standard MTGO format: "<copies> <name>" per line, the sideboard
+    comes after an empty line (or a "Sideboard" line).
+    Without a card database only the structure of the deck is checked.
+    Misspelled names are resolved to the closest card and the deck
+    keeps the right name; the player is told in check.corrections.
+  */
+  DeckCheck check;
+  std::map<std::string, int> copies_by_name;
+  std::stringstream is(raw_deck);
+  std::string line;
+  bool sideboard = false;
+  size_t total = 0;
+  while (std::getline(is, line)) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line == "Sideboard" || line == "Sideboard:") {
+      if (!check.main.empty()) sideboard = true;
+      continue;
+    }
+    std::stringstream is_line(line);
+    int copies = 0;
+    std::string name;
+    is_line >> copies;
+    is_line.ignore(1);
+    if (!is_line || copies <= 0 || !std::getline(is_line, name) || name.empty()) {
+      check.error = "Malformed line: " + line;
+      return check;
+    }
+    if (static_cast<size_t>(copies) > DECK_MAX_CARDS - total) {
+      check.error = "A deck can have at most " + std::to_string(DECK_MAX_CARDS) + " cards";
+      return check;
+    }
+    total += static_cast<size_t>(copies);
+    const CardData* data = db.find(name);
+    if (!data && (data = db.resolve(name))) check.corrections.emplace_back(name, data->name);
+    if (!db.empty()) {
+      if (!data) {
+        check.error = "Unknown card: " + name;
+        return check;
+      }
+      CardLegality legality = data->legality(DECK_FORMAT);
+      if (legality != CardLegality::Unknown && legality != CardLegality::Legal &&
+          legality != CardLegality::Restricted) {
+        check.error = name + " is not legal in " + DECK_FORMAT;
+        return check;
+      }
+      name = data->name;
+    }
+    copies_by_name[name] += copies;
+    CardDefinitionId definition = data ? data->definition : CardDefinitions::instance().intern(name);
+    auto& zone = sideboard ? check.side : check.main;
+    zone.insert(zone.end(), copies, Card(0, definition));
+  }
+  if (check.main.size() < DECK_MIN_MAIN) {
+    check.error = "The main deck needs at least " + std::to_string(DECK_MIN_MAIN) + " cards";
+    return check;
+  }
+  if (check.side.size() > DECK_MAX_SIDEBOARD) {
+    check.error = "The sideboard can have at most " + std::to_string(DECK_MAX_SIDEBOARD) + " cards";
+    return check;
+  }
+  for (auto& [name, copies] : copies_by_name) {
+    const CardData* data = db.find(name);
+    if (is_basic_land(name, data) || (data && data->any_number)) continue;
+    bool restricted = data && data->legality(DECK_FORMAT) == CardLegality::Restricted;
+    int limit = restricted ? 1 : DECK_MAX_COPIES;
+    if (copies > limit) {
+      check.error = "Too many copies of " + name + " (at most " + std::to_string(limit) + ")";
+      return check;
+    }
+  }
+  check.valid = true;
+  return check;
+}
+
+class DeckValidator {
+public:
+  DeckValidator(const CardDatabase& db, unsigned threads)
+    : db(db), pool(threads) {}
+
+  ~DeckValidator() { pool.join(); }
+
+  void validate(std::string raw_deck, std::function<void(DeckCheck)> on_checked) {
+    // The callback runs on a worker thread: the caller posts the
+    // result back to its own strand.
+    // Nothing may escape the job: the pool would terminate the server.
+    boost::asio::post(pool, [this, raw_deck = std::move(raw_deck), on_checked = std::move(on_checked)]() {
+      DeckCheck check;
+      try {
+        check = check_deck(raw_deck, db);
+      } catch (const std::exception& e) {
+        check = DeckCheck();
+        check.error = std::string("Deck check failed: ") + e.what();
+      }
+      on_checked(std::move(check));
+    });
+  }
+
+private:
+  const CardDatabase& db;
+  boost::asio::thread_pool pool;
+};
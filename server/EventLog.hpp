@@ -0,0 +1,320 @@
+#pragma once
+#include <string>
+#include <array>
+#include <deque>
+#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include "Command.hpp"
+#include "Protocol.hpp"
+#include "Log.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+  Append-only binary log of a match.
+  The file starts with a 16 byte header:
+    "PSIMLOG" | version (1 byte) | match id (u32) | reserved (u32)
+  followed by records laid out back to back:
+    payload length (u32) | crc32 (u32) | type (u8) | player (u8) |
+    reserved (u16) | microseconds since the log was opened (u64) | payload
+  The crc covers everything after itself, payload included.
+  Integers are big endian, as in the wire protocol (see Protocol.hpp),
+  and a Command payload is the binary encoding of the command, so a
+  log can be mapped in memory and walked without any parsing step.
+  A crash can leave a partial record at the end of the file: readers
+  stop at the first record that is truncated or fails its checksum.
+*/
+
+#define EVENT_LOG_MAGIC "PSIMLOG"
+#define EVENT_LOG_VERSION 1
+#define EVENT_LOG_HEADER_SIZE 16
+#define EVENT_RECORD_HEADER_SIZE 20
+#define EVENT_LOG_BATCH_SIZE 65536
+#define EVENT_LOG_FLUSH_MS 200
+#define EVENT_LOG_DIR "logs"
+
+enum class EventType : uint8_t {
+  Seat = 0, // player took a seat
+  Command = 1, // command accepted from a player, payload is the command
+  Disconnect = 2, // player connection lost, seat held
+  Reconnect = 3, // player took the seat back
+  GraceExpired = 4, // player didn't come back in time
+  Finish = 5, // match over, payload is the reason
+  DeckChecked = 6, // validation of the last deck upload applied, payload is the error if any
+  Seed = 7 // random seed of the game (u32), before any other event
+};
+
+inline std::string eventTypeToString(EventType type) {
+  switch (type) {
+    case EventType::Seat:         return "Seat";
+    case EventType::Command:      return "Command";
+    case EventType::Disconnect:   return "Disconnect";
+    case EventType::Reconnect:    return "Reconnect";
+    case EventType::GraceExpired: return "GraceExpired";
+    case EventType::Finish:       return "Finish";
+    case EventType::DeckChecked:  return "DeckChecked";
+    case EventType::Seed:         return "Seed";
+    default:                      return "Unknown";
+  }
+}
+
+inline uint32_t crc32(const char* data, size_t len) {
+  // Standard CRC-32 (IEEE), table driven.
+  static const auto table = []() {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++) {
+    crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+class EventLogFlusher {
+  /*
+    Background thread doing the file I/O of every event log: matches
+    only append to memory and hand over whole batches, so a slow disk
+    never stalls a game strand.
+  */
+public:
+  using File = std::shared_ptr<std::FILE>;
+
+  static EventLogFlusher& instance() {
+    static EventLogFlusher flusher;
+    return flusher;
+  }
+
+  void submit(File file, std::string batch) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.emplace_back(std::move(file), std::move(batch));
+    }
+    wakeup.notify_one();
+  }
+
+  ~EventLogFlusher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wakeup.notify_one();
+    worker.join();
+  }
+
+private:
+  EventLogFlusher() : stopping(false), worker([this]() { run(); }) {}
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wakeup.wait(lock, [this]() { return stopping || !queue.empty(); });
+      if (queue.empty()) return; // stopping, everything written
+      std::deque<std::pair<File, std::string>> batches;
+      batches.swap(queue);
+      lock.unlock();
+      for (auto& b : batches) {
+        std::fwrite(b.second.data(), 1, b.second.size(), b.first.get());
+      }
+      for (auto& b : batches) {
+        std::fflush(b.first.get());
+      }
+      batches.clear(); // the last batch of a log closes its file
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::deque<std::pair<File, std::string>> queue;
+  bool stopping;
+  std::thread worker;
+};
+
+class EventLogWriter {
+  /*
+    Used from the strand of its match only. Records are encoded in an
+    in-memory batch, handed to EventLogFlusher when it is full or when
+    the owner calls flush().
+  */
+public:
+  EventLogWriter(const std::string& path, unsigned match_id)
+    : start(std::chrono::steady_clock::now()) {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+      LOG_ERROR(Storage, "Cannot open event log ", path);
+      return;
+    }
+    file = EventLogFlusher::File(f, [](std::FILE* f) { std::fclose(f); });
+    batch.append(EVENT_LOG_MAGIC);
+    batch.push_back(static_cast<char>(EVENT_LOG_VERSION));
+    put_u32(batch, match_id);
+    put_u32(batch, 0);
+  }
+
+  ~EventLogWriter() { flush(); }
+
+  bool is_open() const { return file != nullptr; }
+  bool has_pending() const { return !batch.empty(); }
+
+  void append(EventType type, int player, const std::string& payload = "") {
+    size_t begin = begin_record(type, player);
+    batch.append(payload);
+    end_record(begin);
+  }
+
+  void append(int player, const Command& command) {
+    size_t begin = begin_record(EventType::Command, player);
+    encode_command(command, batch);
+    end_record(begin);
+  }
+
+  void flush() {
+    if (!file || batch.empty()) return;
+    EventLogFlusher::instance().submit(file, std::move(batch));
+    batch.clear();
+    batch.reserve(EVENT_LOG_BATCH_SIZE);
+  }
+
+private:
+  size_t begin_record(EventType type, int player) {
+    size_t begin = batch.size();
+    if (!file) return begin;
+    uint64_t us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
+    put_u32(batch, 0); // length, patched by end_record
+    put_u32(batch, 0); // crc, patched by end_record
+    batch.push_back(static_cast<char>(type));
+    batch.push_back(static_cast<char>(player));
+    batch.push_back(0);
+    batch.push_back(0);
+    put_u32(batch, static_cast<uint32_t>(us >> 32));
+    put_u32(batch, static_cast<uint32_t>(us));
+    return begin;
+  }
+
+  void end_record(size_t begin) {
+    if (!file) {
+      batch.clear();
+      return;
+    }
+    size_t length = batch.size() - begin - EVENT_RECORD_HEADER_SIZE;
+    std::string field;
+    put_u32(field, static_cast<uint32_t>(length));
+    put_u32(field, crc32(&batch[begin + 8], batch.size() - begin - 8));
+    batch.replace(begin, 8, field);
+    if (batch.size() >= EVENT_LOG_BATCH_SIZE) flush();
+  }
+
+  EventLogFlusher::File file;
+  std::string batch;
+  std::chrono::steady_clock::time_point start;
+};
+
+struct EventRecord {
+  EventType type;
+  int player;
+  uint64_t time_us;
+  const char* payload; // points inside the mapped log
+  size_t size;
+};
+
+class EventLogReader {
+  /*
+    Maps a whole log in memory and walks its records in place.
+  */
+public:
+  enum class Status { Ok, End, Truncated, Corrupt };
+
+  explicit EventLogReader(const std::string& path) : data(nullptr), length(0), offset(0), match_id(0) {
+#ifndef _WIN32
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      length = static_cast<size_t>(st.st_size);
+      void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("cannot map " + path);
+      }
+      data = static_cast<const char*>(p);
+    }
+#else
+    std::ifstream is(path, std::ios::binary);
+    if (!is) throw std::runtime_error("cannot open " + path);
+    contents.assign((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    data = contents.data();
+    length = contents.size();
+#endif
+    if (length < EVENT_LOG_HEADER_SIZE || std::memcmp(data, EVENT_LOG_MAGIC, 7) != 0 ||
+        static_cast<unsigned char>(data[7]) != EVENT_LOG_VERSION) {
+      close();
+      throw std::runtime_error(path + " is not an event log");
+    }
+    match_id = get_u32(data + 8);
+    offset = EVENT_LOG_HEADER_SIZE;
+  }
+
+  ~EventLogReader() { close(); }
+  EventLogReader(const EventLogReader&) = delete;
+  EventLogReader& operator=(const EventLogReader&) = delete;
+
+  unsigned get_match_id() const { return match_id; }
+  size_t get_size() const { return length; }
+
+  Status next(EventRecord& record) {
+    if (offset == length) return Status::End;
+    if (length - offset < EVENT_RECORD_HEADER_SIZE) return Status::Truncated;
+    const char* p = data + offset;
+    uint32_t payload_size = get_u32(p);
+    if (length - offset - EVENT_RECORD_HEADER_SIZE < payload_size) return Status::Truncated;
+    if (crc32(p + 8, EVENT_RECORD_HEADER_SIZE - 8 + payload_size) != get_u32(p + 4)) {
+      return Status::Corrupt;
+    }
+    record.type = static_cast<EventType>(p[8]);
+    record.player = static_cast<unsigned char>(p[9]);
+    record.time_us = (static_cast<uint64_t>(get_u32(p + 12)) << 32) | get_u32(p + 16);
+    record.payload = p + EVENT_RECORD_HEADER_SIZE;
+    record.size = payload_size;
+    offset += EVENT_RECORD_HEADER_SIZE + payload_size;
+    return Status::Ok;
+  }
+
+private:
+  void close() {
+#ifndef _WIN32
+    if (data) ::munmap(const_cast<char*>(data), length);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    data = nullptr;
+  }
+
+  const char* data;
+  size_t length;
+  size_t offset;
+  unsigned match_id;
+#ifndef _WIN32
+  int fd;
+#else
+  std::string contents;
+#endif
+};
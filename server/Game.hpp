@@ -0,0 +1,431 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+#include "PublicInfo.hpp"
+#include "PlayerInfo.hpp"
+#include "Card.hpp"
+#include "Command.hpp"
+#include "Messages.hpp"
+#include "DeckValidator.hpp"
+#include "ZoneStore.hpp"
+#include "Turn.hpp"
+#include "LegalActions.hpp"
+
+/*
+  Game rules, without any networking.
+  Match feeds the commands of its connected players here, the replay
+  tool (ReplayMain.cpp) feeds the commands read from an event log:
+  the same inputs must always produce the same state, so nothing in
+  here may depend on time, sockets or the order of other matches.
+  snapshot() / rollback() undo a partial action (or a whole line of
+  play explored by a search) in O(changes): the state must only be
+  changed through the set_ methods and ZoneStore, which journal it.
+
+  The game starts when both players have a valid deck: libraries are
+  shuffled with the seed of the game, both draw GAME_OPENING_HAND cards
+  and a random player goes first. Then turns go through the steps of
+  Turn.hpp; the active player gets priority at the start of each step,
+  two passes in a row resolve the top of the stack or, when it's empty,
+  end the step. After every command the server passes for the player
+  holding priority until someone wants it (see wants_priority), so most
+  steps need no round trip to the clients.
+  Card effects are not implemented yet: spells resolve to the
+  battlefield (permanents) or to the graveyard, costs are generic mana
+  paid by tapping untapped lands.
+  What each player can do is kept by LegalActions: every change below
+  marks what it may affect (a card in or out of a hand, the lands of a
+  player, the step, the stack, the priority), the auto-pass and the
+  actions sent to the clients read from it.
+*/
+
+#define GAME_OPENING_HAND 7
+#define GAME_AUTO_PASS_LIMIT 64 // passes made for the players after one command
+
+// Game state of one player.
+struct Seat {
+  int id; // seat inside the match, assigned by Game::seat
+  PlayerInfo info;
+  bool validated; // player uploaded a valid deck
+  bool ready; // player is ready to start the game
+  Seat() : id(-1), validated(false), ready(false) {}
+};
+
+class Game {
+public:
+  PublicInfo info; // turn is the active player, priority the player holding it
+  ZoneStore zones; // every object of the game
+  std::array<AutoPass, ZONE_STORE_PLAYERS> auto_pass; // settings, not journaled
+
+  Game() : rng(0) {
+    info.turn = 0;
+    info.priority = 0;
+    info.life_points = {20, 20};
+  }
+
+  void set_seed(uint32_t seed) { rng.seed(seed); } // before the game starts
+
+  UndoJournal::Mark snapshot() { return zones.journal.open(); }
+  void rollback(UndoJournal::Mark mark) {
+    zones.journal.rollback(mark);
+    legal.mark_all();
+  }
+  void keep(UndoJournal::Mark mark) { zones.journal.keep(mark); }
+
+  void set_turn(unsigned player) {
+    zones.journal.set(info.turn, player);
+    legal.mark_timing();
+  }
+  void set_priority(unsigned player) {
+    zones.journal.set(info.priority, player);
+    legal.mark_timing();
+  }
+  void set_life(int player, int life) {
+    zones.journal.set(player == 0 ? info.life_points.first : info.life_points.second, life);
+  }
+
+  bool started() const { return state.started; }
+  uint64_t state_version() const { return zones.journal.version(); } // changes with any part of the state
+  Step step() const { return state.step; }
+  unsigned turn_number() const { return state.turn_number; }
+  const std::vector<ZoneStore::Instance>& stack() const { return stack_order; }
+
+  void seat(Seat& seat, int id) {
+    seat.id = id;
+    seat.info.player_id = id;
+  }
+
+  static bool ends_game(const Command& command) {
+    return command.code == CommandCode::Quit || command.code == CommandCode::Resign;
+  }
+
+  std::string process_command(Seat& seat, const Command& command) {
+    // The string is the answer sent to the client.
+    // Deck uploads go through the DeckValidator and accept_deck().
+    if (seat.id < 0 || seat.id >= ZONE_STORE_PLAYERS) return MESSAGE_error_unknown_command;
+    uint8_t player = static_cast<uint8_t>(seat.id);
+    switch (command.code) {
+      case CommandCode::SetStops: {
+        // target: steps of the own turns, extra: steps of the opponent turns
+        StepMask own, opponent;
+        if (!parseStops(command.target, own) || !parseStops(command.extra, opponent)) return MESSAGE_invalid_stops;
+        auto_pass[player].own_stops = own;
+        auto_pass[player].opponent_stops = opponent;
+        run_auto_pass();
+        return MESSAGE_stops_set;
+      }
+      case CommandCode::YieldTurn:
+        if (!state.started) return MESSAGE_game_not_started;
+        auto_pass[player].yield_turn = state.turn_number;
+        run_auto_pass();
+        return MESSAGE_yield_turn;
+      case CommandCode::PassPriority:
+        if (!state.started) return MESSAGE_game_not_started;
+        if (info.priority != player) return MESSAGE_no_priority;
+        pass_priority();
+        run_auto_pass();
+        return MESSAGE_pass_priority;
+      case CommandCode::PlayCard: {
+        // target: id of a card in hand
+        if (!state.started) return MESSAGE_game_not_started;
+        if (info.priority != player) return MESSAGE_no_priority;
+        std::string error = play_card(player, find_card(command.target));
+        if (!error.empty()) return error;
+        run_auto_pass();
+        return MESSAGE_card_played;
+      }
+      default:
+        return MESSAGE_error_unknown_command;
+    }
+  }
+
+  std::string accept_deck(Seat& seat, const DeckCheck& check) {
+    // Creates the cards of a checked deck in the library and the
+    // sideboard of the player, replacing the previous upload.
+    // The second valid deck starts the game.
+    if (!check.valid) return MESSAGE_invalid_deck + check.error;
+    if (state.started) return MESSAGE_deck_locked;
+    if (seat.id < 0 || seat.id >= ZONE_STORE_PLAYERS) return MESSAGE_invalid_deck;
+    uint8_t player = static_cast<uint8_t>(seat.id);
+    for (Zone zone : {Zone::Library, Zone::Sideboard}) {
+      while (zones.top(player, zone) != ZoneStore::npos) destroy(zones.top(player, zone));
+    }
+    if (check.main.size() + check.side.size() > zones.room()) return MESSAGE_invalid_deck;
+    zones.reserve(zones.live() + check.main.size() + check.side.size());
+    for (const Card& card : check.main) create(ObjectKind::Card, card.definition, player, Zone::Library);
+    for (const Card& card : check.side) create(ObjectKind::Card, card.definition, player, Zone::Sideboard);
+    seat.validated = true;
+    zones.journal.set(state.deck_ready[player], true);
+    if (state.deck_ready[0] && state.deck_ready[1]) start();
+    return MESSAGE_correct_deck_upload;
+  }
+
+  size_t zone_size(const Seat& seat, Zone zone) const {
+    if (seat.id < 0 || seat.id >= ZONE_STORE_PLAYERS) return 0;
+    return zones.count(static_cast<uint8_t>(seat.id), zone);
+  }
+
+  std::vector<Card> zone_cards(const Seat& seat, Zone zone) const {
+    if (seat.id < 0 || seat.id >= ZONE_STORE_PLAYERS) return {};
+    return zones.cards(static_cast<uint8_t>(seat.id), zone);
+  }
+
+  bool has_legal_action(uint8_t player) {
+    // Something in hand can be played now.
+    refresh_actions();
+    return legal.count(player) > 0;
+  }
+
+  std::vector<CommandCode> available_commands(const Seat& seat) {
+    // What the client may send now, for its menus.
+    std::vector<CommandCode> commands;
+    if (seat.id < 0 || seat.id >= ZONE_STORE_PLAYERS) return commands;
+    uint8_t player = static_cast<uint8_t>(seat.id);
+    if (!state.started) {
+      commands.push_back(CommandCode::UploadDeck);
+    } else {
+      if (info.priority == player) commands.push_back(CommandCode::PassPriority);
+      if (has_legal_action(player)) commands.push_back(CommandCode::PlayCard);
+      commands.push_back(CommandCode::YieldTurn);
+    }
+    for (CommandCode code : {CommandCode::SetStops, CommandCode::Resign, CommandCode::Quit}) commands.push_back(code);
+    return commands;
+  }
+
+  ActionDiff action_diff(const Seat& seat, bool full = false) {
+    // Cards the player can now play or no longer play since the last
+    // call, see LegalActions.hpp.
+    if (seat.id < 0 || seat.id >= ZONE_STORE_PLAYERS) return ActionDiff();
+    refresh_actions();
+    return legal.take_diff(zones, static_cast<uint8_t>(seat.id), full);
+  }
+
+  static bool is_land(const CardDefinition& definition) {
+    return definition.type.find("Land") != std::string::npos;
+  }
+
+  static bool is_permanent(const CardDefinition& definition) {
+    for (const char* type : {"Land", "Creature", "Artifact", "Enchantment", "Planeswalker", "Battle"}) {
+      if (definition.type.find(type) != std::string::npos) return true;
+    }
+    return false;
+  }
+
+private:
+  struct TurnState {
+    bool started = false;
+    Step step = Step::Untap;
+    unsigned turn_number = 0; // 1 is the first turn of the game
+    uint8_t passes = 0; // consecutive passes, 2 ends the step or resolves the stack
+    uint8_t lands_played = 0; // by the active player this turn
+    std::array<bool, ZONE_STORE_PLAYERS> deck_ready{};
+  };
+
+  void start() {
+    zones.journal.set(state.started, true);
+    legal.mark_all();
+    for (uint8_t player = 0; player < ZONE_STORE_PLAYERS; player++) {
+      shuffle_library(player);
+      for (int i = 0; i < GAME_OPENING_HAND; i++) draw(player);
+    }
+    begin_turn(static_cast<uint8_t>(rng() % ZONE_STORE_PLAYERS));
+    advance_step();
+    run_auto_pass();
+  }
+
+  void shuffle_library(uint8_t player) {
+    std::vector<ZoneStore::Instance> cards;
+    cards.reserve(zones.count(player, Zone::Library));
+    zones.for_each(player, Zone::Library, [&](ZoneStore::Instance card) { cards.push_back(card); });
+    std::shuffle(cards.begin(), cards.end(), rng);
+    for (ZoneStore::Instance card : cards) zones.move(card, Zone::Library);
+  }
+
+  ZoneStore::Instance create(ObjectKind what, CardDefinitionId card, uint8_t player, Zone to) {
+    ZoneStore::Instance instance = zones.create(what, card, player, to);
+    if (instance != ZoneStore::npos) legal.describe(instance, CardDefinitions::instance().get(card));
+    return instance;
+  }
+
+  void destroy(ZoneStore::Instance card) {
+    legal.touch(card);
+    if (zones.zone[card] == Zone::Battlefield) legal.mark_mana(zones.controller[card]);
+    zones.destroy(card);
+  }
+
+  void move(ZoneStore::Instance card, Zone to) {
+    // ZoneStore::move, marking what the legal actions depend on.
+    Zone from = zones.zone[card];
+    if (from == Zone::Hand || to == Zone::Hand) legal.touch(card);
+    if ((from == Zone::Battlefield || to == Zone::Battlefield) && legal.is_land(card)) {
+      legal.mark_mana(zones.controller[card]);
+    }
+    if (from == Zone::Stack || to == Zone::Stack) legal.mark_timing();
+    zones.move(card, to);
+  }
+
+  void tap(ZoneStore::Instance card, bool value) {
+    zones.set_tapped(card, value);
+    if (legal.is_land(card)) legal.mark_mana(zones.controller[card]);
+  }
+
+  void refresh_actions() {
+    legal.update(zones, [this](uint8_t player) {
+      LegalActions::Timing timing;
+      timing.instant = state.started && info.priority == player;
+      timing.land = timing.instant && can_play_land(player);
+      timing.sorcery = timing.instant && sorcery_timing(player);
+      return timing;
+    });
+  }
+
+  void draw(uint8_t player) {
+    // Drawing from an empty library does nothing for now.
+    ZoneStore::Instance card = zones.top(player, Zone::Library);
+    if (card != ZoneStore::npos) move(card, Zone::Hand);
+  }
+
+  void begin_turn(uint8_t player) {
+    set_turn(player);
+    zones.journal.set(state.turn_number, state.turn_number + 1);
+    zones.journal.set(state.lands_played, 0);
+    set_step(Step::Untap);
+    zones.for_each(player, Zone::Battlefield, [&](ZoneStore::Instance card) {
+      if (zones.tapped[card]) tap(card, false);
+    });
+  }
+
+  void advance_step() {
+    // Next step where players get priority.
+    do {
+      Step next = static_cast<Step>(static_cast<uint8_t>(state.step) + 1);
+      if (next == Step::Count) {
+        begin_turn(static_cast<uint8_t>(1 - info.turn));
+        continue;
+      }
+      set_step(next);
+      if (next == Step::Draw && state.turn_number > 1) draw(static_cast<uint8_t>(info.turn));
+    } while (state.step == Step::Untap || state.step == Step::Cleanup);
+    zones.journal.set(state.passes, 0);
+    set_priority(info.turn);
+  }
+
+  void set_step(Step step) {
+    zones.journal.set(state.step, step);
+    legal.mark_timing();
+  }
+
+  void pass_priority() {
+    zones.journal.set(state.passes, state.passes + 1);
+    if (state.passes < ZONE_STORE_PLAYERS) {
+      set_priority(1 - info.priority);
+      return;
+    }
+    zones.journal.set(state.passes, 0);
+    if (!stack_order.empty()) {
+      resolve_top();
+      set_priority(info.turn);
+      return;
+    }
+    advance_step();
+  }
+
+  void resolve_top() {
+    ZoneStore::Instance card = zones.journal.pop_back(stack_order);
+    if (is_permanent(CardDefinitions::instance().get(zones.definition[card]))) {
+      move(card, Zone::Battlefield);
+      return;
+    }
+    if (zones.controller[card] != zones.owner[card]) zones.set_controller(card, zones.owner[card]);
+    move(card, Zone::Graveyard);
+  }
+
+  bool wants_priority(uint8_t player) {
+    const AutoPass& settings = auto_pass[player];
+    if (settings.yield_turn == state.turn_number) return false;
+    if (!has_legal_action(player)) return false; // nothing to respond with
+    if (!stack_order.empty()) return true;
+    StepMask stops = player == info.turn ? settings.own_stops : settings.opponent_stops;
+    return (stops & stepBit(state.step)) != 0;
+  }
+
+  void run_auto_pass() {
+    // Bounded: a game where nobody can ever act would loop forever.
+    for (int i = 0; i < GAME_AUTO_PASS_LIMIT && state.started; i++) {
+      if (wants_priority(static_cast<uint8_t>(info.priority))) return;
+      pass_priority();
+    }
+  }
+
+  ZoneStore::Instance find_card(const std::string& id) const {
+    try {
+      size_t end;
+      unsigned long value = std::stoul(id, &end);
+      if (end != id.size() || value > UINT32_MAX) return ZoneStore::npos;
+      return zones.find(ObjectHandle::from_value(static_cast<uint32_t>(value)));
+    } catch (const std::exception&) {
+      return ZoneStore::npos;
+    }
+  }
+
+  bool can_play_land(uint8_t player) const {
+    return state.lands_played == 0 && sorcery_timing(player);
+  }
+
+  bool sorcery_timing(uint8_t player) const {
+    return player == info.turn && stack_order.empty() && (state.step == Step::Main1 || state.step == Step::Main2);
+  }
+
+  bool has_timing(uint8_t player, const CardDefinition& definition) const {
+    if (definition.type.find("Instant") != std::string::npos || definition.effect.rfind("Flash", 0) == 0) return true;
+    return sorcery_timing(player);
+  }
+
+  bool pay(uint8_t player, int mana) {
+    // Taps untapped lands until mana is paid, false if there aren't
+    // enough: the caller rolls back the lands tapped so far.
+    ZoneStore::Instance card = zones.bottom(player, Zone::Battlefield);
+    while (mana > 0 && card != ZoneStore::npos) {
+      if (!zones.tapped[card] && legal.is_land(card)) {
+        tap(card, true);
+        mana--;
+      }
+      card = zones.next_in_zone(card);
+    }
+    return mana <= 0;
+  }
+
+  std::string play_card(uint8_t player, ZoneStore::Instance card) {
+    // Empty string on success.
+    if (card == ZoneStore::npos || zones.zone[card] != Zone::Hand || zones.controller[card] != player) {
+      return MESSAGE_unknown_card;
+    }
+    const CardDefinition& definition = CardDefinitions::instance().get(zones.definition[card]);
+    if (is_land(definition)) {
+      if (!can_play_land(player)) return MESSAGE_cannot_play;
+      move(card, Zone::Battlefield);
+      zones.journal.set(state.lands_played, state.lands_played + 1);
+      legal.mark_timing();
+    } else {
+      if (!has_timing(player, definition)) return MESSAGE_cannot_play;
+      UndoJournal::Mark mark = snapshot();
+      move(card, Zone::Stack);
+      zones.journal.push_back(stack_order, card);
+      if (!pay(player, definition.cmc)) {
+        rollback(mark);
+        return MESSAGE_cannot_pay;
+      }
+      keep(mark);
+    }
+    // The player keeps priority after acting.
+    zones.journal.set(state.passes, 0);
+    return "";
+  }
+
+  TurnState state;
+  LegalActions legal; // derived from the state, not journaled: rollback() marks it all dirty
+  std::vector<ZoneStore::Instance> stack_order; // bottom to top, across both players
+  std::mt19937 rng; // only used when the game starts, so replays match
+};
@@ -0,0 +1,215 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "CardDefinitions.hpp"
+#include "ZoneStore.hpp"
+
+/*
+  The cards each player can play right now, kept up to date from dirty
+  flags instead of being worked out again after every priority pass.
+  Game marks what its changes may affect: a card that entered or left
+  a hand (touch), the lands of a player (mark_mana), the step, the
+  stack or the priority holder (mark_timing). update() then re-checks
+  only the touched cards, or the hand of a player whose mana or timing
+  really changed. What a card needs to be played (land or spell, speed,
+  cost) is read from its definition once, when the object is described,
+  so the checks are comparisons of a few cached bytes.
+  Every change of the castable set is queued per player until
+  take_diff(), which gives the cards added and removed since the last
+  call: Match only sends those to the client.
+  Card effects are not implemented yet, so there are no activated
+  abilities nor targets to offer: only lands and spells from the hand.
+*/
+
+enum class ActionKind : uint8_t {
+  PlayLand = 0,
+  Cast
+};
+
+inline const char* actionKindToString(ActionKind kind) {
+  return kind == ActionKind::PlayLand ? "play_land" : "cast";
+}
+
+struct ActionDiff {
+  std::vector<std::pair<ObjectHandle, ActionKind>> added;
+  std::vector<ObjectHandle> removed;
+  bool empty() const { return added.empty() && removed.empty(); }
+};
+
+class LegalActions {
+public:
+  using Instance = ZoneStore::Instance;
+
+  // When the player can play what, given by Game.
+  struct Timing {
+    bool land = false; // may play a land now
+    bool instant = false; // holds priority
+    bool sorcery = false; // holds priority in an own main phase, empty stack
+    bool operator==(const Timing& other) const {
+      return land == other.land && instant == other.instant && sorcery == other.sorcery;
+    }
+  };
+
+  void describe(Instance instance, const CardDefinition& definition) {
+    // Called when an object is created, before any touch.
+    if (instance >= land.size()) grow(instance + 1);
+    land[instance] = definition.type.find("Land") != std::string::npos;
+    instant[instance] = definition.type.find("Instant") != std::string::npos || definition.effect.rfind("Flash", 0) == 0;
+    cost[instance] = definition.cmc;
+  }
+
+  bool is_land(Instance instance) const { return land[instance] != 0; }
+
+  void touch(Instance instance) {
+    // The object entered or left a hand, or was destroyed.
+    if (touched_flag[instance]) return;
+    touched_flag[instance] = 1;
+    touched.push_back(instance);
+  }
+
+  void mark_mana(uint8_t player) { dirty[player].mana = true; }
+
+  void mark_timing() {
+    for (Dirty& flags : dirty) flags.timing = true;
+  }
+
+  void mark_all() {
+    // After a rollback: the state changed behind our back.
+    for (Dirty& flags : dirty) flags = Dirty{true, true, true};
+  }
+
+  template <typename TimingOf>
+  void update(const ZoneStore& zones, TimingOf timing_of) {
+    for (uint8_t player = 0; player < ZONE_STORE_PLAYERS; player++) {
+      Dirty& flags = dirty[player];
+      if (!flags.mana && !flags.timing && !flags.full) continue;
+      bool changed = flags.full;
+      if (flags.mana) {
+        int lands = 0;
+        zones.for_each(player, Zone::Battlefield, [&](Instance i) {
+          if (land[i] && !zones.tapped[i]) lands++;
+        });
+        changed = changed || lands != mana[player];
+        mana[player] = lands;
+      }
+      if (flags.timing || flags.full) {
+        Timing now = timing_of(player);
+        changed = changed || !(now == timing[player]);
+        timing[player] = now;
+      }
+      if (changed) recheck_hand(zones, player, flags.full);
+      flags = Dirty();
+    }
+    for (Instance i : touched) {
+      touched_flag[i] = 0;
+      bool in_hand = zones.zone[i] == Zone::Hand;
+      set(i, in_hand ? zones.controller[i] : holder[i], in_hand && check(i, zones.controller[i]));
+    }
+    touched.clear();
+  }
+
+  size_t count(uint8_t player) const { return castable_list[player].size(); }
+
+  ActionDiff take_diff(const ZoneStore& zones, uint8_t player, bool full = false) {
+    // Changes since the last call, or the whole set if full (the
+    // client starts over, e.g. after a reconnection).
+    ActionDiff diff;
+    std::vector<ObjectHandle>& given = sent[player];
+    for (Instance i : queued[player]) {
+      queued_flag[i] &= static_cast<uint8_t>(~(1u << player));
+      ObjectHandle now = castable[i] && holder[i] == player ? zones.handle(i) : ObjectHandle();
+      if (given[i] == now) continue;
+      if (!full && given[i].valid()) diff.removed.push_back(given[i]);
+      if (!full && now.valid()) diff.added.push_back({now, kind(i)});
+      given[i] = now;
+    }
+    queued[player].clear();
+    if (full) {
+      for (Instance i : castable_list[player]) diff.added.push_back({given[i], kind(i)});
+    }
+    return diff;
+  }
+
+private:
+  struct Dirty {
+    bool mana = false;
+    bool timing = false;
+    bool full = false; // re-check every card, even if nothing seems changed
+  };
+
+  ActionKind kind(Instance i) const { return land[i] ? ActionKind::PlayLand : ActionKind::Cast; }
+
+  bool check(Instance i, uint8_t player) const {
+    const Timing& now = timing[player];
+    if (land[i]) return now.land;
+    return (instant[i] ? now.instant : now.sorcery) && cost[i] <= mana[player];
+  }
+
+  void recheck_hand(const ZoneStore& zones, uint8_t player, bool full) {
+    // Cards that left the hand were touched; after a rollback they
+    // weren't, so the old set is checked too.
+    if (full) {
+      std::vector<Instance> previous = castable_list[player];
+      for (Instance i : previous) {
+        if (zones.zone[i] != Zone::Hand || zones.controller[i] != player) set(i, player, false);
+      }
+    }
+    zones.for_each(player, Zone::Hand, [&](Instance i) { set(i, player, check(i, player)); });
+  }
+
+  void set(Instance i, uint8_t player, bool value) {
+    if (castable[i] == value && holder[i] == player) return;
+    if (castable[i]) {
+      auto& list = castable_list[holder[i]];
+      for (size_t k = 0; k < list.size(); k++) {
+        if (list[k] == i) {
+          list[k] = list.back();
+          list.pop_back();
+          break;
+        }
+      }
+      queue(holder[i], i);
+    }
+    castable[i] = value;
+    holder[i] = player;
+    if (value) {
+      castable_list[player].push_back(i);
+      queue(player, i);
+    }
+  }
+
+  void queue(uint8_t player, Instance i) {
+    if (queued_flag[i] & (1u << player)) return;
+    queued_flag[i] |= static_cast<uint8_t>(1u << player);
+    queued[player].push_back(i);
+  }
+
+  void grow(size_t size) {
+    land.resize(size, 0);
+    instant.resize(size, 0);
+    cost.resize(size, 0);
+    castable.resize(size, 0);
+    holder.resize(size, 0);
+    touched_flag.resize(size, 0);
+    queued_flag.resize(size, 0);
+    for (auto& given : sent) given.resize(size);
+  }
+
+  // Per object, indexed like the ZoneStore arrays.
+  std::vector<uint8_t> land;
+  std::vector<uint8_t> instant;
+  std::vector<int> cost;
+  std::vector<uint8_t> castable;
+  std::vector<uint8_t> holder; // player the castable flag is for
+  std::vector<uint8_t> touched_flag;
+  std::vector<uint8_t> queued_flag; // one bit per player
+  std::array<std::vector<ObjectHandle>, ZONE_STORE_PLAYERS> sent; // as last given to each player by take_diff
+
+  std::vector<Instance> touched;
+  std::array<Dirty, ZONE_STORE_PLAYERS> dirty;
+  std::array<Timing, ZONE_STORE_PLAYERS> timing;
+  std::array<int, ZONE_STORE_PLAYERS> mana{};
+  std::array<std::vector<Instance>, ZONE_STORE_PLAYERS> castable_list;
+  std::array<std::vector<Instance>, ZONE_STORE_PLAYERS> queued;
+};
@@ -0,0 +1,672 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <functional>
+#include <chrono>
+#include <array>
+#include <optional>
+#include <random>
+#include <utility> // before asio: Boost 1.74 coroutine headers miss it under C++20
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include "PublicInfo.hpp"
+#include "Card.hpp"
+#include "PlayerInfo.hpp"
+#include "Command.hpp"
+#include "Protocol.hpp"
+#include "Messages.hpp"
+#include "Game.hpp"
+#include "DeckValidator.hpp"
+#include "EventLog.hpp"
+#include "Player.hpp"
+#include "SpectatorHub.hpp"
+#include "Metrics.hpp"
+#include "Log.hpp"
+
+#define MATCH_PLAYERS 2
+#define RECONNECT_GRACE_SECONDS 30
+#define MISSED_FRAMES_LIMIT 256
+#define SESSION_IDLE_TIMEOUT_SECONDS 900
+#define FRAME_READ_TIMEOUT_SECONDS 30
+
+/*
+  A Match owns everything that belongs to a single game: the seated
+  players and the Game with the rules and the public state.
+  The server keeps as many matches alive as there are tables being
+  played, each one is independent from the others.
+  Every asynchronous operation keeps the match alive through
+  shared_from_this(), so the server can forget about a finished match
+  while its last callbacks are still pending.
+  All the handlers of a match run on its own strand: the io_context
+  can be run by many threads but the game logic of a single table
+  never runs concurrently, so it needs no locking.
+  Each player connection is a coroutine running on that strand
+  (read_loop), watched by a second one enforcing the read timeouts.
+  When a player of a running game disconnects, the seat is held for
+  RECONNECT_GRACE_SECONDS: a client presenting the session token it
+  received when seated gets the seat back, a snapshot of the state and
+  the messages it missed.
+  Every accepted command and every seat change is appended to the
+  event log of the match (see EventLog.hpp), so the game can be
+  replayed offline with replay_app.
+  Spectators only receive the public state (never PlayerInfo) and
+  the public announcements, through the SpectatorHub of the match.
+*/
+class Match : public std::enable_shared_from_this<Match> {
+public:
+  Match(boost::asio::io_context& io, unsigned match_id,
+        std::function<void(unsigned)> on_finished,
+        std::function<void(std::shared_ptr<Player>)> on_rejected,
+        DeckValidator& deck_validator, const std::string& log_path = "")
+    : id(match_id), strand(boost::asio::make_strand(io)), deck_validator(deck_validator),
+      spectator_hub(std::make_shared<SpectatorHub>(io)), connected_players(0),
+      finished(false), enqueued_bytes(0), log_timer(io), log_timer_armed(false),
+      on_finished(std::move(on_finished)), on_rejected(std::move(on_rejected)) {
+    if (!log_path.empty()) {
+      event_log = std::make_unique<EventLogWriter>(log_path, match_id);
+    }
+    // Shuffles and the first player must not be predictable from the
+    // match id, which spectators know: the seed is only in the log.
+    uint32_t seed = std::random_device()();
+    game.set_seed(seed);
+    std::string payload;
+    put_u32(payload, seed);
+    if (event_log) event_log->append(EventType::Seed, 0, payload); // flushed with the next events
+  }
+
+  unsigned get_id() const { return id; }
+
+  void join(std::shared_ptr<Player> new_player) {
+    // Can be called from any thread: seating happens on the match strand.
+    boost::asio::dispatch(strand,
+      std::bind(&Match::add_player, shared_from_this(), new_player));
+  }
+
+  void rejoin(std::shared_ptr<Player> new_player) {
+    // Same as join() for a client presenting its session token.
+    boost::asio::dispatch(strand,
+      std::bind(&Match::resume_player, shared_from_this(), new_player));
+  }
+
+  void spectate(std::shared_ptr<Spectator> spectator) {
+    // Attaches a read-only observer, from any thread.
+    boost::asio::dispatch(strand,
+      std::bind(&Match::add_spectator, shared_from_this(), spectator));
+  }
+
+private:
+  using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+  // When and how big a command frame arrived, for its metrics.
+  struct CommandReceipt {
+    std::chrono::steady_clock::time_point received;
+    uint64_t bytes_in;
+  };
+
+  bool is_full() const { return players.size() >= MATCH_PLAYERS; }
+
+  void add_player(std::shared_ptr<Player> new_player) {
+    /*
+      Seats a freshly accepted connection at this table.
+      Starts the loop that waits for that specific player commands
+      and tells everyone when the table is full.
+      The server may hand us a player right after the table closed,
+      in that case the player is given back to be seated elsewhere.
+    */
+    if (finished || is_full()) {
+      if (on_rejected) on_rejected(new_player);
+      return;
+    }
+    game.seat(*new_player, static_cast<int>(players.size()));
+    log_event(EventType::Seat, new_player->id);
+    new_player->connected = true;
+    seats_changed = true;
+    players.push_back(new_player);
+    connected_players++;
+    Metrics::instance().connections++;
+    LOG_INFO(Match, "Player ", new_player->id, " connected to match ", id, ".");
+    // Start reading from this player
+    start_session(new_player);
+    send_message(new_player, MESSAGE_connection_established);
+    send_message(new_player, MESSAGE_session_token + new_player->session_token);
+    if (is_full()){
+      broadcast_message("2 players are connected to the server.");
+    }
+    publish_state();
+    // The lobby may have read a game command before seating the player.
+    if (new_player->first_command) {
+      Command command = *new_player->first_command;
+      new_player->first_command.reset();
+      handle_command(new_player, command);
+    }
+  }
+
+  void resume_player(std::shared_ptr<Player> new_player) {
+    /*
+      Gives a seat back to a reconnecting client.
+      If the server didn't notice yet that the previous connection
+      is dead, the new one simply takes it over.
+    */
+    std::shared_ptr<Player> previous;
+    for (auto& p : players) {
+      if (p->session_token == new_player->session_token) previous = p;
+    }
+    if (finished || !previous) {
+      boost::system::error_code ignored;
+      new_player->socket.close(ignored);
+      return;
+    }
+    if (previous->connected) {
+      boost::system::error_code ignored;
+      previous->socket.close(ignored);
+      mark_disconnected(previous);
+    }
+    new_player->inherit_seat(*previous);
+    players[new_player->id] = new_player;
+    log_event(EventType::Reconnect, new_player->id);
+    new_player->connected = true;
+    seats_changed = true;
+    connected_players++;
+    Metrics::instance().connections++;
+    LOG_INFO(Match, "Player ", new_player->id, " reconnected to match ", id, ".");
+    start_session(new_player);
+    send_message(new_player, MESSAGE_reconnected);
+    send_message(new_player, MESSAGE_snapshot + snapshot(new_player));
+    std::deque<SharedFrame> missed = std::move(new_player->missed_frames);
+    new_player->missed_frames.clear();
+    for (auto& frame : missed) {
+      send_frame(new_player, frame);
+    }
+    send_actions(new_player, true); // after the missed diffs, it replaces them
+    for (auto& p : players) {
+      if (p != new_player) {
+        send_message(p, "Player " + std::to_string(new_player->id) + " is back.");
+      }
+    }
+    publish_state();
+  }
+
+  void add_spectator(std::shared_ptr<Spectator> spectator) {
+    if (finished) {
+      boost::system::error_code ignored;
+      spectator->socket.close(ignored);
+      return;
+    }
+    // The hub has the latest state once this publish has run,
+    // posts from this strand reach it in order.
+    publish_state();
+    spectator_hub->add(spectator,
+      make_shared_frame(MESSAGE_spectating + std::to_string(id) + "."));
+  }
+
+  std::string public_state() {
+    // What anyone watching the table can know, no PlayerInfo here.
+    nlohmann::json j;
+    j["match_id"] = id;
+    j["turn"] = game.info.turn;
+    j["priority"] = game.info.priority;
+    j["life_points"] = game.info.life_points;
+    j["started"] = game.started();
+    j["turn_number"] = game.turn_number();
+    j["step"] = stepToString(game.step());
+    j["stack"] = nlohmann::json::array();
+    for (ZoneStore::Instance card : game.stack()) {
+      j["stack"].push_back({{"id", game.zones.handle(card).value},
+                            {"title", game.zones.card(card).title()},
+                            {"controller", game.zones.controller[card]}});
+    }
+    j["players"] = nlohmann::json::array();
+    for (auto& p : players) {
+      nlohmann::json battlefield = nlohmann::json::array();
+      for (const Card& card : game.zone_cards(*p, Zone::Battlefield)) {
+        battlefield.push_back({{"id", card.id}, {"title", card.title()},
+                               {"tapped", game.zones.tapped[ObjectHandle::from_value(card.id).index()] != 0}});
+      }
+      j["players"].push_back({
+        {"player_id", p->id},
+        {"connected", p->connected},
+        {"validated", p->validated},
+        {"library_size", game.zone_size(*p, Zone::Library)},
+        {"hand_size", game.zone_size(*p, Zone::Hand)},
+        {"graveyard_size", game.zone_size(*p, Zone::Graveyard)},
+        {"battlefield", battlefield},
+      });
+    }
+    return j.dump();
+  }
+
+  void publish_state() {
+    // Encodes the public state once for the players and all the
+    // spectators, only when it changed since the last time: players
+    // learn from it who has priority in which step, then each of them
+    // gets what changed in its own legal actions.
+    // The state is only rebuilt when the game or a seat changed, so a
+    // command that changes nothing costs no JSON.
+    if (seats_changed || game.state_version() != published_version) {
+      seats_changed = false;
+      published_version = game.state_version();
+      std::string state = public_state();
+      if (state != last_public_state) {
+        last_public_state = state;
+        SharedFrame frame = make_shared_frame(MESSAGE_public_state + state);
+        for (auto& player : players) {
+          send_frame(player, frame);
+        }
+        spectator_hub->publish(frame, true);
+      }
+    }
+    for (auto& player : players) {
+      send_actions(player);
+    }
+  }
+
+  std::string snapshot(std::shared_ptr<Player> player) {
+    // Compact state for a reconnecting client: public state plus
+    // its own private information, the deck list is not sent back.
+    nlohmann::json j;
+    j["match_id"] = id;
+    j["player_id"] = player->info.player_id;
+    j["turn"] = game.info.turn;
+    j["priority"] = game.info.priority;
+    j["life_points"] = game.info.life_points;
+    j["started"] = game.started();
+    j["turn_number"] = game.turn_number();
+    j["step"] = stepToString(game.step());
+    j["validated"] = player->validated;
+    j["hand_cards"] = game.zone_cards(*player, Zone::Hand);
+    j["library_size"] = game.zone_size(*player, Zone::Library);
+    j["sideboard_size"] = game.zone_size(*player, Zone::Sideboard);
+    return j.dump();
+  }
+
+  void start_session(std::shared_ptr<Player> player) {
+    // Runs the read loop of the player and its watchdog on the strand.
+    set_read_deadline(player, SESSION_IDLE_TIMEOUT_SECONDS);
+    boost::asio::co_spawn(strand, read_loop(player), boost::asio::detached);
+    boost::asio::co_spawn(strand, watchdog(player), boost::asio::detached);
+  }
+
+  void set_read_deadline(std::shared_ptr<Player> player, int seconds) {
+    // A later deadline is picked up when the watchdog wakes up,
+    // an earlier one needs to wake it now.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    bool earlier = deadline < player->read_deadline;
+    player->read_deadline = deadline;
+    if (earlier) player->read_timer.cancel();
+  }
+
+  boost::asio::awaitable<void> read_loop(std::shared_ptr<Player> player) {
+    /*
+      One frame at a time: read the header, read the body in chunks
+      (see Framing.hpp), decode and dispatch, then start again.
+      Every read has a deadline enforced by watchdog(): a player can
+      stay idle for SESSION_IDLE_TIMEOUT_SECONDS, but a frame that
+      started arriving must be complete in FRAME_READ_TIMEOUT_SECONDS.
+      Any error, the socket closed by the watchdog or by the game
+      included, ends the loop in handle_disconnect().
+    */
+    auto self = shared_from_this(); // the match lives as long as its sessions
+    try {
+      while (player->connected) {
+        set_read_deadline(player, SESSION_IDLE_TIMEOUT_SECONDS);
+        co_await boost::asio::async_read(player->socket,
+          boost::asio::buffer(player->reader.header_data(), player->reader.header_size()),
+          boost::asio::use_awaitable);
+        if (!player->reader.begin()) {
+          // The peer announced more than MAX_MESSAGE_SIZE bytes:
+          // we can't resync the stream, so drop the connection.
+          LOG_WARN(Match, "Player ", player->id, " of match ", id, " sent an oversized message");
+          boost::system::error_code ignored;
+          player->socket.close(ignored);
+          handle_disconnect(player, boost::asio::error::message_size);
+          co_return;
+        }
+        set_read_deadline(player, FRAME_READ_TIMEOUT_SECONDS);
+        size_t length;
+        do {
+          size_t chunk_size;
+          char* chunk = player->reader.next_chunk(chunk_size);
+          length = co_await boost::asio::async_read(player->socket,
+            boost::asio::buffer(chunk, chunk_size), boost::asio::use_awaitable);
+        } while (!player->reader.consume(length));
+        dispatch_frame(player, std::chrono::steady_clock::now());
+        player->reader.reset();
+      }
+    } catch (const boost::system::system_error& e) {
+      bool expired = player->read_deadline <= std::chrono::steady_clock::now();
+      handle_disconnect(player, expired ? boost::asio::error::timed_out : e.code());
+    }
+  }
+
+  boost::asio::awaitable<void> watchdog(std::shared_ptr<Player> player) {
+    // Closes the socket when the deadline set by read_loop() expires,
+    // which cancels the pending read. Stops with the connection.
+    auto self = shared_from_this();
+    boost::system::error_code ec;
+    while (player->connected) {
+      player->read_timer.expires_at(player->read_deadline);
+      co_await player->read_timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+      if (player->connected && player->read_deadline <= std::chrono::steady_clock::now()) {
+        LOG_INFO(Match, "Player ", player->id, " of match ", id, " timed out.");
+        boost::system::error_code ignored;
+        player->socket.close(ignored);
+        co_return;
+      }
+    }
+  }
+
+  void dispatch_frame(std::shared_ptr<Player> player, std::chrono::steady_clock::time_point received) {
+    // Deserialize the Command, binary or JSON (see Protocol.hpp)
+    // Metrics: from the last byte of the frame received to the answers
+    // and the new state queued, decoding included.
+    Command command;
+    if (decode_command(player->reader.data(), player->reader.size(), command)) {
+      CommandReceipt receipt{received, player->reader.size() + player->reader.header_size()};
+      uint64_t bytes_before = enqueued_bytes;
+      bool answered = handle_command(player, command, receipt);
+      publish_state(); // the state and actions it changed are part of the answer
+      if (answered) {
+        Metrics::instance().record_command(command.code, receipt.bytes_in,
+          enqueued_bytes - bytes_before,
+          std::chrono::steady_clock::now() - received);
+      }
+    } else {
+      LOG_WARN(Match, "Malformed command from player ", player->id, " of match ", id);
+      send_message(player, "Invalid command format");
+    }
+  }
+
+  void handle_disconnect(std::shared_ptr<Player> player, boost::system::error_code ec) {
+  // simple handling of disconnection of a player.
+    if (player->connected) {
+      LOG_INFO(Match, "Player ", player->id, " of match ", id, " disconnected: ", ec.message());
+      mark_disconnected(player);
+      if (finished) return; // game already over, nothing left to notify
+      log_event(EventType::Disconnect, player->id);
+      if (!is_full()) {
+        // Nobody to play against yet, the table is closed.
+        broadcast_message("Player " + std::to_string(player->id) + " has left the game");
+        handle_player_resignation(player);
+        return;
+      }
+      // Hold the seat: a network blip must not end the game.
+      broadcast_message("Player " + std::to_string(player->id) + " disconnected, waiting " +
+                        std::to_string(RECONNECT_GRACE_SECONDS) + " seconds for reconnection.");
+      player->awaiting_reconnect = true;
+      player->grace_timer.expires_after(std::chrono::seconds(RECONNECT_GRACE_SECONDS));
+      player->grace_timer.async_wait(boost::asio::bind_executor(strand,
+        std::bind(&Match::handle_grace_expired, shared_from_this(), player, std::placeholders::_1)));
+      publish_state();
+    }
+  }
+
+  void handle_grace_expired(std::shared_ptr<Player> player, boost::system::error_code ec) {
+    // The player didn't come back in time: same as a resignation.
+    if (ec || finished || !player->awaiting_reconnect) return;
+    player->awaiting_reconnect = false;
+    log_event(EventType::GraceExpired, player->id);
+    // Notify other players about disconnection
+    broadcast_message("Player " + std::to_string(player->id) + " has left the game");
+    // Handle game state changes due to disconnection
+    handle_player_resignation(player);
+  }
+
+  bool handle_command(std::shared_ptr<Player> player, const Command &command,
+                      std::optional<CommandReceipt> receipt = std::nullopt) {
+      // False when the answer comes later, from another handler that
+      // then records the metrics of the command.
+      LOG_DEBUG(Match, "Match ", id, ", received command from player ", player->id, ": ", command.toString());
+      if (event_log) {
+        event_log->append(player->id, command);
+        schedule_log_flush();
+      }
+      if (Game::ends_game(command)) {
+        handle_player_resignation(player);
+        return true;
+      }
+      if (command.code == CommandCode::UploadDeck) {
+        if (game.started()) {
+          // Decks are locked: no need to check it first.
+          send_message(player, MESSAGE_deck_locked);
+          return true;
+        }
+        check_deck_upload(player, command.target, receipt);
+        return false;
+      }
+      // Process the command for the player with priority
+      std::string response = game.process_command(*player, command);
+      send_message(player, response);
+      // Update game state and notify all players if needed
+      return true;
+  }
+
+  void check_deck_upload(std::shared_ptr<Player> player, const std::string& raw_deck,
+                         std::optional<CommandReceipt> receipt) {
+    // Parsing and validation run on the DeckValidator workers,
+    // the answer is sent when the result comes back to the strand.
+    unsigned upload = ++player->deck_uploads;
+    int seat = player->id;
+    auto self = shared_from_this();
+    deck_validator.validate(raw_deck, [self, seat, upload, receipt](DeckCheck check) {
+      boost::asio::post(self->strand, [self, seat, upload, receipt, check = std::move(check)]() {
+        self->apply_deck_check(seat, upload, check, receipt);
+      });
+    });
+  }
+
+  void apply_deck_check(int seat, unsigned upload, const DeckCheck& check,
+                        std::optional<CommandReceipt> receipt) {
+    // The seat may have a new connection after a reconnection,
+    // the result of an older upload is dropped.
+    if (finished) return;
+    std::shared_ptr<Player> player = players[seat];
+    if (upload != player->deck_uploads) return;
+    log_event(EventType::DeckChecked, seat, check.error);
+    bool started = game.started();
+    std::string response = game.accept_deck(*player, check);
+    if (response == MESSAGE_correct_deck_upload) {
+      LOG_INFO(Deck, "Player ", seat, " of match ", id, " uploaded a deck: ",
+               game.zone_size(*player, Zone::Library), " main, ",
+               game.zone_size(*player, Zone::Sideboard), " sideboard");
+    } else {
+      LOG_INFO(Deck, "Player ", seat, " of match ", id, " deck refused: ", response);
+    }
+    uint64_t bytes_before = enqueued_bytes;
+    send_message(player, response);
+    if (response == MESSAGE_correct_deck_upload && !check.corrections.empty()) {
+      // Typos are accepted, but the player must see what was read.
+      std::string corrections;
+      for (const auto& [written, card] : check.corrections) {
+        corrections += (corrections.empty() ? "" : ", ") + written + " -> " + card;
+      }
+      send_message(player, MESSAGE_deck_corrections + corrections);
+    }
+    if (!started && game.started()) {
+      LOG_INFO(Match, "Match ", id, " started, player ", game.info.turn, " plays first.");
+      broadcast_message("Player " + std::to_string(game.info.turn) + " plays first.");
+    }
+    publish_state();
+    if (receipt) {
+      // The whole upload: queued for validation, checked, answered.
+      Metrics::instance().record_command(CommandCode::UploadDeck, receipt->bytes_in,
+        enqueued_bytes - bytes_before, std::chrono::steady_clock::now() - receipt->received);
+    }
+  }
+
+  void handle_player_resignation(std::shared_ptr<Player> player) {
+    // Just disconnects every player and closes the table.
+    if (finished) return;
+    std::string message = "Player " + std::to_string(player->id) + " has resigned. Game over.";
+    broadcast_message(message);
+    // Close all connections of this match
+    for (auto& p : players) {
+      if (p->connected && p != player) {
+        try {
+            p->socket.close();
+        } catch (...) {}
+        mark_disconnected(p);
+      }
+    }
+    LOG_INFO(Match, "Match ", id, ": ", message);
+    log_event(EventType::Finish, player->id, message);
+    finish();
+  }
+
+  void mark_disconnected(std::shared_ptr<Player> player) {
+    player->connected = false;
+    seats_changed = true;
+    player->read_timer.cancel(); // stops the watchdog
+    connected_players--;
+    Metrics::instance().connections--;
+    Metrics::instance().send_queue_depth -= player->send_queue.clear();
+  }
+
+  void finish() {
+    // Tells the server that this table can be forgotten.
+    finished = true;
+    for (auto& p : players) {
+      p->awaiting_reconnect = false;
+      p->grace_timer.cancel();
+      p->missed_frames.clear();
+    }
+    publish_state();
+    spectator_hub->close();
+    log_timer.cancel();
+    if (event_log) event_log->flush();
+    if (on_finished) on_finished(id);
+  }
+
+  void log_event(EventType type, int player, const std::string& payload = "") {
+    if (!event_log) return;
+    event_log->append(type, player, payload);
+    schedule_log_flush();
+  }
+
+  void schedule_log_flush() {
+    // Appending only fills memory: the batch is handed to the
+    // flusher thread at most EVENT_LOG_FLUSH_MS later.
+    if (log_timer_armed) return;
+    log_timer_armed = true;
+    log_timer.expires_after(std::chrono::milliseconds(EVENT_LOG_FLUSH_MS));
+    log_timer.async_wait(boost::asio::bind_executor(strand,
+      [self = shared_from_this()](boost::system::error_code ec) {
+        self->log_timer_armed = false;
+        if (!ec) self->event_log->flush();
+      }));
+  }
+
+  void send_message(std::shared_ptr<Player> player, const std::string& message) {
+    // Sends a message to target player only.
+    send_frame(player, make_shared_frame(message));
+  }
+
+  void send_frame(std::shared_ptr<Player> player, const SharedFrame& frame) {
+    // Queues an encoded frame for target player and starts sending it
+    // unless a write is already running on that socket.
+    // Frames for a seat waiting for reconnection are kept aside.
+    if (!player->connected) {
+      if (player->awaiting_reconnect) {
+        player->missed_frames.push_back(frame);
+        if (player->missed_frames.size() > MISSED_FRAMES_LIMIT) {
+          player->missed_frames.pop_front(); // the snapshot covers the state anyway
+        }
+      }
+      return;
+    }
+    player->send_queue.push(frame);
+    enqueued_bytes += frame->size();
+    Metrics::instance().send_queue_depth++;
+    flush(player);
+  }
+
+  void flush(std::shared_ptr<Player> player) {
+    // Sends with a single gathered write everything queued so far.
+    // The callback sends what has been queued in the meantime.
+    if (!player->connected || !player->send_queue.start()) return;
+    auto self = shared_from_this();
+    boost::asio::async_write(player->socket, player->send_queue.buffers(),
+      boost::asio::bind_executor(strand,
+        [self, player](boost::system::error_code ec, std::size_t /*length*/) {
+          Metrics::instance().send_queue_depth -= player->send_queue.done();
+          if (ec) { // if error during sending...
+            Metrics::instance().send_queue_depth -= player->send_queue.clear();
+            self->handle_disconnect(player, ec);
+            return;
+          }
+          self->flush(player);
+        }));
+  }
+
+  void broadcast_message(const std::string& message) {
+    // Sends a string to all players of this match.
+    // The frame is encoded once and shared by every send queue.
+    // Announcements are public, spectators get them too.
+    SharedFrame frame = make_shared_frame(message);
+    for (auto& player : players) {
+      send_frame(player, frame);
+    }
+    spectator_hub->publish(frame);
+  }
+
+  void send_player_info(std::shared_ptr<Player> player) {
+    // Sends private information to target player.
+    nlohmann::json j;
+    j["player_id"] = player->info.player_id;
+    j["hand_cards"] = game.zone_cards(*player, Zone::Hand);
+    send_message(player, j.dump());
+  }
+
+// void send_public_info(std::shared_ptr<Player> player) {
+//   // Sends information about game state to target player.
+//   nlohmann::json j;
+//   j["turn"] = info.turn;
+//   j["priority"] = info.priority;
+//   j["life_points"] =  info.life_points;
+//   send_message(player, j.dump());
+// }
+
+  void send_actions(std::shared_ptr<Player> player, bool full = false) {
+    /*
+      Sends the commands the player can use and the cards it can play,
+      only what changed since the last frame unless full (the client
+      then drops what it knew). Nothing is sent when nothing changed,
+      so a priority pass costs the few cards it touched.
+    */
+    ActionDiff diff = game.action_diff(*player, full);
+    std::vector<CommandCode> commands = game.available_commands(*player);
+    std::vector<CommandCode>& sent = sent_commands[player->id];
+    if (!full && diff.empty() && commands == sent) return;
+    nlohmann::json j;
+    if (full) j["reset"] = true;
+    if (full || commands != sent) j["commands"] = serializeCommandCodeVector(commands);
+    sent = commands;
+    j["add"] = nlohmann::json::array();
+    for (auto& [handle, kind] : diff.added) {
+      j["add"].push_back({{"id", handle.value}, {"action", actionKindToString(kind)}});
+    }
+    j["remove"] = nlohmann::json::array();
+    for (ObjectHandle handle : diff.removed) j["remove"].push_back(handle.value);
+    send_message(player, MESSAGE_actions + j.dump());
+  }
+
+  unsigned id;
+  Strand strand;
+  DeckValidator& deck_validator; // shared by every match, owned by the server
+  std::shared_ptr<SpectatorHub> spectator_hub;
+  std::string last_public_state; // last state sent to the spectators
+  uint64_t published_version = UINT64_MAX; // game.state_version() of last_public_state
+  bool seats_changed = true; // a player joined, left or came back since last_public_state
+  std::array<std::vector<CommandCode>, MATCH_PLAYERS> sent_commands; // by send_actions, per seat
+  std::vector<std::shared_ptr<Player>> players;
+  Game game;
+  int connected_players;
+  bool finished;
+  uint64_t enqueued_bytes; // all frames queued by this match, for metrics
+  std::unique_ptr<EventLogWriter> event_log;
+  boost::asio::steady_timer log_timer;
+  bool log_timer_armed;
+  std::function<void(unsigned)> on_finished;
+  std::function<void(std::shared_ptr<Player>)> on_rejected;
+};
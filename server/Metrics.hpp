@@ -0,0 +1,209 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <chrono>
+#include "Command.hpp"
+
+/*
+  Server instrumentation.
+  Everything is made of relaxed atomics: matches record from whatever
+  thread runs their strand and the metrics endpoint reads concurrently,
+  a slightly torn snapshot is fine for monitoring.
+  Rendered in the Prometheus text format by MetricsServer.hpp.
+*/
+
+// HDR-style histogram of latencies in microseconds: values are grouped
+// by power of two, each power of two is split in HISTOGRAM_SUB_BUCKETS
+// linear buckets, so the relative error is bounded by 1/16 on the
+// whole range (1us up to more than an hour).
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_GROUPS 32
+#define METRICS_CODE_SLOTS 16
+
+class LatencyHistogram {
+public:
+  LatencyHistogram() : sum_us(0), count(0) {
+    for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+  }
+
+  void record(uint64_t us) {
+    buckets[bucket_index(us)].fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(us, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static size_t bucket_index(uint64_t us) {
+    // Values below HISTOGRAM_SUB_BUCKETS have a bucket each, then
+    // every power of two gets HISTOGRAM_SUB_BUCKETS buckets.
+    if (us < HISTOGRAM_SUB_BUCKETS) return static_cast<size_t>(us);
+    unsigned msb = 0;
+    for (uint64_t v = us; v > 1; v >>= 1) msb++;
+    unsigned group = msb - HISTOGRAM_SUB_BITS + 1;
+    if (group >= HISTOGRAM_GROUPS) return HISTOGRAM_GROUPS * HISTOGRAM_SUB_BUCKETS - 1;
+    size_t sub = static_cast<size_t>((us >> (msb - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+    return group * HISTOGRAM_SUB_BUCKETS + sub;
+  }
+
+  static uint64_t bucket_upper_bound(size_t index) {
+    // Largest value (inclusive) that falls in the bucket.
+    if (index < HISTOGRAM_SUB_BUCKETS) return index;
+    size_t group = index / HISTOGRAM_SUB_BUCKETS;
+    size_t sub = index % HISTOGRAM_SUB_BUCKETS;
+    unsigned shift = static_cast<unsigned>(group - 1);
+    return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+  }
+
+  uint64_t get_count() const { return count.load(std::memory_order_relaxed); }
+  uint64_t get_sum() const { return sum_us.load(std::memory_order_relaxed); }
+
+  uint64_t quantile(double q) const {
+    uint64_t total = get_count();
+    if (total == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+      seen += buckets[i].load(std::memory_order_relaxed);
+      if (seen >= rank) return bucket_upper_bound(i);
+    }
+    return bucket_upper_bound(buckets.size() - 1);
+  }
+
+  void render(std::ostringstream& out, const std::string& name, const std::string& labels) const {
+    /*
+      Prometheus histogram. Exposing every fine bucket would be
+      hundreds of series per command, so cumulative counts are
+      exported at power of two boundaries. The precise quantiles,
+      computed on the fine buckets, are exported by render_quantiles().
+    */
+    uint64_t cumulative = 0;
+    size_t next_bound = HISTOGRAM_SUB_BUCKETS - 1;
+    for (size_t i = 0; i < buckets.size(); i++) {
+      cumulative += buckets[i].load(std::memory_order_relaxed);
+      if (i == next_bound) {
+        out << name << "_bucket{" << labels << ",le=\"" << (bucket_upper_bound(i) + 1) / 1e6
+            << "\"} " << cumulative << "\n";
+        next_bound += HISTOGRAM_SUB_BUCKETS;
+      }
+    }
+    out << name << "_bucket{" << labels << ",le=\"+Inf\"} " << get_count() << "\n";
+    out << name << "_sum{" << labels << "} " << get_sum() / 1e6 << "\n";
+    out << name << "_count{" << labels << "} " << get_count() << "\n";
+  }
+
+  void render_quantiles(std::ostringstream& out, const std::string& name, const std::string& labels) const {
+    for (double q : {0.5, 0.99, 0.999}) {
+      out << name << "{" << labels << ",quantile=\"" << q << "\"} "
+          << quantile(q) / 1e6 << "\n";
+    }
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, HISTOGRAM_GROUPS * HISTOGRAM_SUB_BUCKETS> buckets;
+  std::atomic<uint64_t> sum_us;
+  std::atomic<uint64_t> count;
+};
+
+struct CommandMetrics {
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> bytes_in{0};
+  std::atomic<uint64_t> bytes_out{0};
+  LatencyHistogram latency;
+};
+
+class Metrics {
+public:
+  static Metrics& instance() {
+    static Metrics metrics;
+    return metrics;
+  }
+
+  void record_command(CommandCode code, uint64_t bytes_in, uint64_t bytes_out,
+                      std::chrono::steady_clock::duration elapsed) {
+    CommandMetrics& m = commands[slot(code)];
+    m.count.fetch_add(1, std::memory_order_relaxed);
+    m.bytes_in.fetch_add(bytes_in, std::memory_order_relaxed);
+    m.bytes_out.fetch_add(bytes_out, std::memory_order_relaxed);
+    m.latency.record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+  }
+
+  // Gauges
+  std::atomic<int64_t> connections{0};
+  std::atomic<int64_t> matches{0};
+  std::atomic<int64_t> send_queue_depth{0};
+  std::atomic<int64_t> spectators{0};
+  // Counters
+  std::atomic<uint64_t> spectator_frames_dropped{0};
+
+  std::string render() const {
+    std::ostringstream out;
+    out.precision(12); // bucket boundaries must be printed exactly
+    out << "# HELP psim_connections Players currently connected.\n"
+        << "# TYPE psim_connections gauge\n"
+        << "psim_connections " << connections.load(std::memory_order_relaxed) << "\n"
+        << "# HELP psim_matches Matches currently open, lobby included.\n"
+        << "# TYPE psim_matches gauge\n"
+        << "psim_matches " << matches.load(std::memory_order_relaxed) << "\n"
+        << "# HELP psim_send_queue_depth Frames queued and not yet written, all sockets.\n"
+        << "# TYPE psim_send_queue_depth gauge\n"
+        << "psim_send_queue_depth " << send_queue_depth.load(std::memory_order_relaxed) << "\n"
+        << "# HELP psim_spectators Spectators currently watching a match.\n"
+        << "# TYPE psim_spectators gauge\n"
+        << "psim_spectators " << spectators.load(std::memory_order_relaxed) << "\n"
+        << "# HELP psim_spectator_frames_dropped_total Frames skipped because a spectator was too slow.\n"
+        << "# TYPE psim_spectator_frames_dropped_total counter\n"
+        << "psim_spectator_frames_dropped_total " << spectator_frames_dropped.load(std::memory_order_relaxed) << "\n";
+    out << "# HELP psim_commands_total Commands received.\n"
+        << "# TYPE psim_commands_total counter\n";
+    for_each_code([&](const std::string& labels, const CommandMetrics& m) {
+      out << "psim_commands_total{" << labels << "} " << m.count.load(std::memory_order_relaxed) << "\n";
+    });
+    out << "# HELP psim_command_bytes_in_total Bytes received with commands, framing included.\n"
+        << "# TYPE psim_command_bytes_in_total counter\n";
+    for_each_code([&](const std::string& labels, const CommandMetrics& m) {
+      out << "psim_command_bytes_in_total{" << labels << "} " << m.bytes_in.load(std::memory_order_relaxed) << "\n";
+    });
+    out << "# HELP psim_command_bytes_out_total Bytes queued to the players in answer to commands, state updates included.\n"
+        << "# TYPE psim_command_bytes_out_total counter\n";
+    for_each_code([&](const std::string& labels, const CommandMetrics& m) {
+      out << "psim_command_bytes_out_total{" << labels << "} " << m.bytes_out.load(std::memory_order_relaxed) << "\n";
+    });
+    out << "# HELP psim_command_latency_seconds From command received to answer and state queued.\n"
+        << "# TYPE psim_command_latency_seconds histogram\n";
+    for_each_code([&](const std::string& labels, const CommandMetrics& m) {
+      m.latency.render(out, "psim_command_latency_seconds", labels);
+    });
+    out << "# HELP psim_command_latency_quantile_seconds Latency quantiles from the fine histogram buckets.\n"
+        << "# TYPE psim_command_latency_quantile_seconds gauge\n";
+    for_each_code([&](const std::string& labels, const CommandMetrics& m) {
+      m.latency.render_quantiles(out, "psim_command_latency_quantile_seconds", labels);
+    });
+    return out.str();
+  }
+
+private:
+  Metrics() = default;
+
+  static size_t slot(CommandCode code) {
+    // Known opcodes are small, everything else shares the last slot.
+    size_t opcode = static_cast<size_t>(code);
+    return opcode < METRICS_CODE_SLOTS - 1 ? opcode : METRICS_CODE_SLOTS - 1;
+  }
+
+  template <typename F>
+  void for_each_code(F&& f) const {
+    // Only commands that have been seen at least once are exported.
+    for (size_t i = 0; i < METRICS_CODE_SLOTS; i++) {
+      if (commands[i].count.load(std::memory_order_relaxed) == 0) continue;
+      CommandCode code = i == METRICS_CODE_SLOTS - 1
+        ? CommandCode::Unknown : commandCodeFromOpcode(static_cast<uint8_t>(i));
+      f("code=\"" + commandCodeToString(code) + "\"", commands[i]);
+    }
+  }
+
+  std::array<CommandMetrics, METRICS_CODE_SLOTS> commands;
+};
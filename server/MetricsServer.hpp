@@ -0,0 +1,104 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <chrono>
+#include <utility>
+#include <boost/asio.hpp>
+#include "Metrics.hpp"
+#include "Log.hpp"
+
+#define METRICS_PORT 9100
+#define METRICS_MAX_REQUEST 4096
+#define METRICS_TIMEOUT_SECONDS 5 // to send the request and read the answer
+
+using boost::asio::ip::tcp;
+
+/*
+  Minimal HTTP endpoint exposing Metrics in the Prometheus text format
+  on GET /metrics. GET /log shows the log levels (see Log.hpp) and
+  GET /log?match=debug,server=warn changes them. It listens on the loopback interface only and runs
+  on the same io_context as the game server: every request is served
+  with a couple of asynchronous operations, then the socket is closed.
+  A connection that hasn't been answered within METRICS_TIMEOUT_SECONDS
+  is closed, so idle ones don't pile up.
+  Each connection runs on its own strand, shared by its deadline timer.
+*/
+class MetricsServer {
+public:
+  MetricsServer(boost::asio::io_context& io, unsigned short port)
+    : io_context(io),
+      acceptor(io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)) {}
+
+  void start() {
+    LOG_INFO(Metrics, "Metrics available on http://127.0.0.1:", acceptor.local_endpoint().port(), "/metrics");
+    accept_connections();
+  }
+
+private:
+  void accept_connections() {
+    auto socket = std::make_shared<tcp::socket>(boost::asio::make_strand(io_context));
+    acceptor.async_accept(*socket, [this, socket](boost::system::error_code ec) {
+      if (ec == boost::asio::error::operation_aborted) return;
+      if (!ec) serve(socket);
+      accept_connections();
+    });
+  }
+
+  void serve(std::shared_ptr<tcp::socket> socket) {
+    // Reads the request head, only the request line is looked at.
+    auto deadline = std::make_shared<boost::asio::steady_timer>(socket->get_executor());
+    deadline->expires_after(std::chrono::seconds(METRICS_TIMEOUT_SECONDS));
+    deadline->async_wait([socket](boost::system::error_code ec) {
+      if (ec) return; // answered
+      boost::system::error_code ignored;
+      socket->close(ignored);
+    });
+    auto request = std::make_shared<boost::asio::streambuf>(METRICS_MAX_REQUEST);
+    boost::asio::async_read_until(*socket, *request, "\r\n\r\n",
+      [this, socket, request, deadline](boost::system::error_code ec, std::size_t) {
+        if (ec) {
+          deadline->cancel();
+          return;
+        }
+        std::istream is(request.get());
+        std::string method, target;
+        is >> method >> target;
+        respond(socket, deadline, method, target);
+      });
+  }
+
+  void respond(std::shared_ptr<tcp::socket> socket, std::shared_ptr<boost::asio::steady_timer> deadline,
+               const std::string& method, const std::string& target) {
+    std::string status = "200 OK";
+    std::string body;
+    if (method != "GET") {
+      status = "405 Method Not Allowed";
+    } else if (target == "/metrics") {
+      body = Metrics::instance().render();
+    } else if (target == "/log" || target.rfind("/log?", 0) == 0) {
+      if (target.size() > 5 && !Log::instance().configure(target.substr(5))) {
+        status = "400 Bad Request";
+        body = "Expected /log?level or /log?subsystem=level,...\n";
+      } else {
+        body = Log::instance().describe();
+      }
+    } else {
+      status = "404 Not Found";
+    }
+    auto response = std::make_shared<std::string>(
+      "HTTP/1.0 " + status + "\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: " + std::to_string(body.size()) + "\r\n"
+      "Connection: close\r\n\r\n" + body);
+    boost::asio::async_write(*socket, boost::asio::buffer(*response),
+      [socket, response, deadline](boost::system::error_code, std::size_t) {
+        deadline->cancel();
+        boost::system::error_code ignored;
+        socket->shutdown(tcp::socket::shutdown_both, ignored);
+        socket->close(ignored);
+      });
+  }
+
+  boost::asio::io_context& io_context;
+  tcp::acceptor acceptor;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "UndoJournal.hpp"
+
+/*
+  Slot allocator for the game objects of a match (cards, tokens,
+  abilities on the stack, emblems). The objects themselves live in the
+  parallel arrays of ZoneStore, indexed by slot: the arena only decides
+  which slot a new object takes and keeps a generation per slot.
+  A handle is the slot index plus the generation the slot had when the
+  object was created, packed in 32 bits so it can be sent to clients as
+  the id of a card: once the object is destroyed the slot is reused
+  with a new generation, and old handles stop resolving instead of
+  silently pointing to another object. Generations wrap after 4096
+  reuses of the same slot.
+  Nothing is freed one object at a time: the slots of a match go away
+  with its Game, a few vectors released at once.
+  Changes are recorded in the journal of the caller, so that creating
+  or destroying objects can be rolled back with the rest of the game.
+*/
+
+#define OBJECT_INDEX_BITS 20
+#define OBJECT_INDEX_MASK ((1u << OBJECT_INDEX_BITS) - 1)
+#define OBJECT_GENERATION_MASK ((1u << (32 - OBJECT_INDEX_BITS)) - 1)
+#define OBJECT_ARENA_CAPACITY OBJECT_INDEX_MASK // the all ones index is the invalid handle
+
+struct ObjectHandle {
+  uint32_t value;
+
+  ObjectHandle() : value(UINT32_MAX) {}
+  ObjectHandle(uint32_t index, uint32_t generation)
+    : value((generation & OBJECT_GENERATION_MASK) << OBJECT_INDEX_BITS | (index & OBJECT_INDEX_MASK)) {}
+
+  static ObjectHandle from_value(uint32_t value) {
+    ObjectHandle handle;
+    handle.value = value;
+    return handle;
+  }
+
+  uint32_t index() const { return value & OBJECT_INDEX_MASK; }
+  uint32_t generation() const { return value >> OBJECT_INDEX_BITS; }
+  bool valid() const { return value != UINT32_MAX; }
+  bool operator==(const ObjectHandle& other) const { return value == other.value; }
+  bool operator!=(const ObjectHandle& other) const { return value != other.value; }
+};
+
+class ObjectArena {
+public:
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  size_t slots() const { return generation.size(); } // ever used, live or free
+  size_t live() const { return generation.size() - free_slots.size(); }
+
+  uint32_t allocate(UndoJournal& journal) {
+    // A free slot if any, else a new one at the end; npos when full.
+    if (!free_slots.empty()) {
+      uint32_t index = journal.pop_back(free_slots);
+      journal.set(alive, index, true);
+      return index;
+    }
+    if (generation.size() >= OBJECT_ARENA_CAPACITY) return npos;
+    journal.push_back(generation, 0);
+    journal.push_back(alive, true);
+    return static_cast<uint32_t>(generation.size() - 1);
+  }
+
+  void release(uint32_t index, UndoJournal& journal) {
+    if (!alive[index]) return;
+    journal.set(alive, index, false);
+    journal.set(generation, index, (generation[index] + 1) & OBJECT_GENERATION_MASK);
+    journal.push_back(free_slots, index);
+  }
+
+  ObjectHandle handle(uint32_t index) const { return ObjectHandle(index, generation[index]); }
+
+  bool contains(ObjectHandle handle) const {
+    uint32_t index = handle.index();
+    return index < generation.size() && alive[index] && generation[index] == handle.generation();
+  }
+
+private:
+  std::vector<uint32_t> generation;
+  std::vector<uint8_t> alive;
+  std::vector<uint32_t> free_slots;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <optional>
+#include <chrono>
+#include <utility>
+#include <boost/asio.hpp>
+#include "Command.hpp"
+#include "Game.hpp"
+#include "Framing.hpp"
+#include "SendQueue.hpp"
+
+using boost::asio::ip::tcp;
+
+// A connection seated at a match, the game state is in Seat.
+class Player : public Seat {
+public:
+  tcp::socket socket;
+  bool connected;
+
+  FrameReader reader;
+  // Deadline of the pending read, enforced by the watchdog of Match.
+  std::chrono::steady_clock::time_point read_deadline;
+  boost::asio::steady_timer read_timer;
+  SendQueue send_queue;
+  // Session handling: the token lets the client take its seat back
+  // after a disconnection, the seat is held until grace_timer expires
+  // and the frames it misses meanwhile are kept in missed_frames.
+  std::string session_token;
+  std::optional<Command> first_command; // read by the lobby before seating
+  bool awaiting_reconnect;
+  boost::asio::steady_timer grace_timer;
+  std::deque<SharedFrame> missed_frames;
+  unsigned deck_uploads; // only the result of the last upload is applied
+  Player(boost::asio::io_context& io)
+      : socket(io), connected(false), read_timer(io),
+        awaiting_reconnect(false), grace_timer(io), deck_uploads(0) {}
+  void inherit_seat(Player& previous) {
+    // A reconnecting client gets a new connection object that
+    // takes over the game state of its previous connection.
+    static_cast<Seat&>(*this) = std::move(static_cast<Seat&>(previous));
+    missed_frames = std::move(previous.missed_frames);
+    deck_uploads = previous.deck_uploads;
+    previous.awaiting_reconnect = false;
+    previous.grace_timer.cancel();
+  }
+};
@@ -0,0 +1,163 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "Game.hpp"
+#include "EventLog.hpp"
+#include "Protocol.hpp"
+
+/*
+  Offline replay of match event logs written by server_app.
+  The commands of the log are fed again to the game rules (Game.hpp),
+  without sockets or timers, and the final state is printed: useful to
+  reproduce a bug or to check what happened in a disputed game.
+  Run it from the directory of the server: the card database in
+  data/ must be the one the server used.
+
+  Usage: ./replay_app [--verbose] [--repeat N] LOG [LOG ...]
+  --verbose prints every event with the answer of the game,
+  --repeat replays each log N times to measure the replay speed.
+*/
+
+struct ReplayResult {
+  Game game;
+  std::vector<Seat> seats;
+  std::vector<std::string> uploads; // last deck uploaded by each seat
+  uint64_t events = 0;
+  uint64_t commands = 0;
+  std::string outcome = "still running";
+  EventLogReader::Status status = EventLogReader::Status::End;
+};
+
+void replay(EventLogReader& reader, ReplayResult& result, const CardDatabase& db, bool verbose) {
+  EventRecord record;
+  Command command;
+  while ((result.status = reader.next(record)) == EventLogReader::Status::Ok) {
+    result.events++;
+    if (record.player >= static_cast<int>(result.seats.size())) {
+      result.seats.resize(record.player + 1);
+      result.uploads.resize(record.player + 1);
+    }
+    Seat& seat = result.seats[record.player];
+    if (verbose) {
+      std::cout << std::setw(12) << record.time_us << "us " << eventTypeToString(record.type)
+                << " player " << record.player;
+    }
+    switch (record.type) {
+      case EventType::Seed:
+        if (record.size == 4) result.game.set_seed(get_u32(record.payload));
+        break;
+      case EventType::Seat:
+        result.game.seat(seat, record.player);
+        break;
+      case EventType::Command: {
+        if (!decode_binary_command(record.payload, record.size, command)) {
+          if (verbose) std::cout << ": undecodable command\n";
+          continue;
+        }
+        result.commands++;
+        if (verbose) std::cout << ": " << command.toString();
+        if (command.code == CommandCode::UploadDeck) {
+          // Applied by the DeckChecked event that follows.
+          result.uploads[record.player] = command.target;
+        } else if (!Game::ends_game(command)) {
+          std::string response = result.game.process_command(seat, command);
+          if (verbose) std::cout << " -> " << response;
+        }
+        break;
+      }
+      case EventType::DeckChecked: {
+        // The server already checked the deck against its card
+        // database: only its outcome matters here, the cards are
+        // rebuilt from the upload. The rules look at the card types,
+        // so the replay needs the same database as the server.
+        DeckCheck check;
+        if (record.size == 0) check = check_deck(result.uploads[record.player], db);
+        else check.error = std::string(record.payload, record.size);
+        std::string response = result.game.accept_deck(seat, check);
+        if (verbose) std::cout << ": " << response;
+        break;
+      }
+      case EventType::Finish:
+        result.outcome = std::string(record.payload, record.size);
+        if (verbose) std::cout << ": " << result.outcome;
+        break;
+      default:
+        break;
+    }
+    if (verbose) std::cout << "\n";
+  }
+}
+
+void print_result(const std::string& path, unsigned match_id, const ReplayResult& result) {
+  std::cout << path << ": match " << match_id << ", " << result.events << " events, "
+            << result.commands << " commands\n"
+            << "  outcome: " << result.outcome << "\n"
+            << "  turn " << result.game.info.turn << ", priority " << result.game.info.priority
+            << ", life " << result.game.info.life_points.first << "/" << result.game.info.life_points.second
+            << ", objects " << result.game.zones.live() << "\n";
+  if (result.game.started()) {
+    std::cout << "  game turn " << result.game.turn_number() << ", step " << stepToString(result.game.step())
+              << ", stack " << result.game.stack().size() << "\n";
+  }
+  for (const Seat& seat : result.seats) {
+    if (seat.id < 0) continue;
+    std::cout << "  player " << seat.id << ": " << (seat.validated ? "deck validated" : "no valid deck")
+              << ", main " << result.game.zone_size(seat, Zone::Library)
+              << ", sideboard " << result.game.zone_size(seat, Zone::Sideboard) << "\n";
+  }
+  if (result.status == EventLogReader::Status::Truncated) {
+    std::cout << "  log truncated after the last complete event\n";
+  } else if (result.status == EventLogReader::Status::Corrupt) {
+    std::cout << "  checksum mismatch, replay stopped at the corrupted event\n";
+  }
+}
+
+int main(int argc, char* argv[]) {
+  bool verbose = false;
+  unsigned repeat = 1;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--verbose") verbose = true;
+    else if (arg == "--repeat" && i + 1 < argc) repeat = std::max(1ul, std::stoul(argv[++i]));
+    else paths.push_back(arg);
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: ./replay_app [--verbose] [--repeat N] LOG [LOG ...]\n";
+    return 1;
+  }
+  CardDatabase db;
+  db.load();
+  if (db.empty()) {
+    std::cerr << "No local card database (" << CARD_INDEX_FILE << " or " << CARD_DATABASE_BULK_FILE << "), "
+              << "games that started are not replayed faithfully\n";
+  }
+  uint64_t total_events = 0;
+  double total_seconds = 0;
+  for (const auto& path : paths) {
+    try {
+      EventLogReader reader(path);
+      ReplayResult result;
+      for (unsigned r = 0; r < repeat; r++) {
+        EventLogReader pass(path);
+        result = ReplayResult();
+        result.game.set_seed(pass.get_match_id()); // logs older than the Seed event
+        auto begin = std::chrono::steady_clock::now();
+        replay(pass, result, db, verbose && r == 0);
+        total_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        total_events += result.events;
+      }
+      print_result(path, reader.get_match_id(), result);
+    } catch (const std::exception& e) {
+      std::cerr << path << ": " << e.what() << "\n";
+    }
+  }
+  if (total_seconds > 0) {
+    std::cout << "replayed " << total_events << " events in " << std::fixed << std::setprecision(3)
+              << total_seconds << " s (" << std::setprecision(0) << total_events / total_seconds
+              << " events/s)\n";
+  }
+  return 0;
+}
@@ -2,372 +2,340 @@
 #include <string>
 #include <vector>
 #include <memory>
-#include <cstring>
-#include <array>
+#include <thread>
+#include <random>
+#include <unordered_map>
 #include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <filesystem>
+#include <utility>
+#include <stdexcept>
 #include <boost/asio.hpp>
-#include <nlohmann/json.hpp>
-#include "PublicInfo.hpp"
-#include "Card.hpp"
-#include "PlayerInfo.hpp"
-#include "Command.hpp"
-#include "Messages.hpp"
-#include "Scryfall.hpp"
+#include "Match.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
 
 #define PORT 5000
+#define HANDSHAKE_TIMEOUT_SECONDS 10
 
 using boost::asio::ip::tcp;
-using json = nlohmann::json;
-
-class Player {
-public:
-  int id;
-  tcp::socket socket;
-  PlayerInfo info;
-  bool connected;
-  bool validated; // player uploaded a valid deck
-  bool ready; // player is ready to start the game
- 
-  std::vector<char> read_buffer;
-  uint32_t expected_message_length;
-  bool reading_header;
-  // private server information
-  std::vector<Card> deck; 
-  std::vector<Card> sideboard;
-  Player(boost::asio::io_context& io, int player_id) 
-      : id(player_id), socket(io), connected(false), validated(false),
-        ready(false), expected_message_length(0), reading_header(true) {
-      read_buffer.resize(65536); // 64KB buffer
-  }
-  void print_raw_deck(){
-    std::cout<<"Main deck"<<"("<<deck.size()<<"):\n";
-    for(auto &c:deck){
-      std::cout<<c.title<<std::endl;
-    }
-    std::cout<<"Sideboard"<<"("<<sideboard.size()<<"):\n";
-    for(auto &c:sideboard){
-      std::cout<<c.title<<std::endl;
-    }
-  }
-};
 
 class GameServer {
 private:
+  using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+
   boost::asio::io_context& io_context;
+  // Lobby handlers (accept, seating, match bookkeeping) run here,
+  // matches run on their own strands.
+  Strand strand;
   tcp::acceptor acceptor;
-  std::vector<std::shared_ptr<Player>> players;
-  PublicInfo info;
-  int connected_players;
- 
+  // Every table currently being played, indexed by match id.
+  std::unordered_map<unsigned, std::shared_ptr<Match>> matches;
+  // Table waiting for opponents: new connections are seated here.
+  std::shared_ptr<Match> lobby;
+  size_t lobby_seats;
+  unsigned next_match_id;
+  // Session tokens of the seated players and the match they belong to.
+  std::unordered_map<std::string, unsigned> sessions;
+  std::unordered_map<unsigned, std::vector<std::string>> match_sessions;
+  // Event logs of this run, one file per match (see EventLog.hpp).
+  std::string log_dir;
+  // Deck uploads of every match are checked by these workers.
+  CardDatabase card_database;
+  std::unique_ptr<DeckValidator> deck_validator;
+
 public:
-  GameServer(boost::asio::io_context& io) 
-    : io_context(io), acceptor(io, tcp::endpoint(tcp::v4(), PORT)), 
-      connected_players(0){
-    info.turn = 0;
-    info.priority = 0;
-    info.card_id = 0;
-    info.life_points = {20, 20};
+  GameServer(boost::asio::io_context& io, const std::string& logs_root, unsigned validation_threads)
+    : io_context(io), strand(boost::asio::make_strand(io)),
+      acceptor(io, tcp::endpoint(tcp::v4(), PORT)),
+      lobby_seats(0), next_match_id(0){
+    card_database.load();
+    if (card_database.empty()) {
+      LOG_WARN(Deck, "No local card database, only the structure of the decks is checked.");
+    } else {
+      LOG_INFO(Deck, "Card database: ", card_database.size(), " cards.");
+    }
+    deck_validator = std::make_unique<DeckValidator>(card_database, validation_threads);
+    // Match ids restart from 0 at every run, so every run
+    // gets its own directory.
+    std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    log_dir = logs_root + "/" + stamp;
+    std::error_code ec;
+    std::filesystem::create_directories(log_dir, ec);
+    if (ec) {
+      LOG_ERROR(Storage, "Cannot create ", log_dir, ", match logs disabled: ", ec.message());
+      log_dir.clear();
+    }
   }
-  
+
   void start() {
-    std::cout << "Server started. Waiting for players...\n";
-    accept_connections();
+    LOG_INFO(Server, "Server started. Waiting for players...");
+    boost::asio::dispatch(strand, std::bind(&GameServer::accept_connections, this));
   }
-    
+
 private:
   void accept_connections() {
     /*
-      Function called as the server starts.
-      The acceptor waits for async connections.
+      Function called as the server starts and after every accepted
+      connection: the server never stops accepting, new players
+      are paired into new matches by the lobby.
       When a client connects, the connection is handled
       by the "handle_accept()" function, wrapped around the "async_accept()"
       method of the acceptor.
      */
-    if (connected_players >= 2) return;
-    auto new_player = std::make_shared<Player>(io_context, connected_players);
+    auto new_player = std::make_shared<Player>(io_context);
     /*
       &GameServer -> function pointer
-      Need to bind function pointer to the current game server instance, 
+      Need to bind function pointer to the current game server instance,
       we do that with std::bind and pass also the pointer with "this".
      */
     acceptor.async_accept(
       new_player->socket,
-      std::bind(&GameServer::handle_accept, this, new_player, std::placeholders::_1)
+      boost::asio::bind_executor(strand,
+        std::bind(&GameServer::handle_accept, this, new_player, std::placeholders::_1))
     );
   }
 
   void handle_accept(std::shared_ptr<Player> new_player,boost::system::error_code ec) {
-    /*
-      This function initializes some player specific information.
-      Then if the game needs one more player, the "accept_connections()" loop
-      is triggered again. Otherwise the game can start.
-      This function also starts the loop that waits for that specific
-      player commands.
-    */
     if (!ec) {
-      new_player->connected = true;
-      players.push_back(new_player);
-      connected_players++;
-      std::cout << "Player " << new_player->id << " connected.\n";
-      // Start reading from this player
-      // Blocking operation: deck upload.
-      start_read(new_player);
-      send_message(new_player, "Connection established.");
-      if (connected_players < 2) {
-          accept_connections(); // Accept next player
-      }
-      if (connected_players == 2){
-        broadcast_message("2 players are connected to the server.");
-      }
+      boost::asio::co_spawn(strand, handshake(new_player), boost::asio::detached);
     } else {
-      std::cerr << "Accept error: " << ec.message() << "\n";
+      LOG_ERROR(Server, "Accept error: ", ec.message());
+      if (ec == boost::asio::error::operation_aborted) return;
     }
+    accept_connections(); // Accept next player
   }
 
-  void start_read(std::shared_ptr<Player> player) {
-    // If the player is ready, starts reading commands.
-    // Otherwise, will read a deck upload.
-    if (!player->connected) return;
-    else if (player->reading_header) {
-      // Read message length (4 bytes)
-      // handle_read_header is the callback.
-      // _1 and _2 are passed from asio: the error code
-      // and the size_t.
-      // reads 4 bytes(sizeof uint32_t) into the address
-      // of the player's expected_message_length.
-      boost::asio::async_read(
-        player->socket,
-        boost::asio::buffer(&player->expected_message_length, sizeof(uint32_t)),
-        std::bind(&GameServer::handle_read_header, this, player, std::placeholders::_1, std::placeholders::_2)
-      );
+  boost::asio::awaitable<void> handshake(std::shared_ptr<Player> player) {
+    /*
+      The first command of a connection decides where it goes:
+      Join takes a new seat, Reconnect takes back the seat of the
+      session token in the target, Spectate watches the match whose
+      id is in the target. Older clients start straight with
+      a game command, which is handed to the match, or send nothing
+      until the player uploads a deck: a connection still silent after
+      HANDSHAKE_TIMEOUT_SECONDS is seated, with no deadline on its
+      first command. One that starts a command has
+      HANDSHAKE_TIMEOUT_SECONDS to finish it.
+    */
+    boost::asio::steady_timer timeout(io_context);
+    auto silent = std::make_shared<bool>(true);
+    timeout.expires_after(std::chrono::seconds(HANDSHAKE_TIMEOUT_SECONDS));
+    timeout.async_wait(boost::asio::bind_executor(strand, [player, silent](boost::system::error_code ec) {
+      if (ec || !*silent) return;
+      boost::system::error_code ignored;
+      player->socket.cancel(ignored); // ends the wait below, nothing has been read
+    }));
+    try {
+      co_await player->socket.async_wait(tcp::socket::wait_read, boost::asio::use_awaitable);
+    } catch (const boost::system::system_error& e) {
+      if (e.code() == boost::asio::error::operation_aborted && player->socket.is_open()) {
+        seat_player(player);
+      }
+      co_return;
     }
-    else {
-        // Read the actual message
-        // reads expected_message_length bytes, previously read thanks
-        // to the header.
-      boost::asio::async_read(
-        player->socket,
-        boost::asio::buffer(player->read_buffer.data(), player->expected_message_length),
-        std::bind(&GameServer::handle_read_body, this, player, std::placeholders::_1, std::placeholders::_2)
-      );
+    *silent = false;
+    timeout.cancel();
+    timeout.expires_after(std::chrono::seconds(HANDSHAKE_TIMEOUT_SECONDS));
+    timeout.async_wait(boost::asio::bind_executor(strand, [player](boost::system::error_code ec) {
+      if (ec) return; // handshake done
+      boost::system::error_code ignored;
+      player->socket.close(ignored);
+    }));
+    Command command;
+    bool valid;
+    try {
+      co_await boost::asio::async_read(player->socket,
+        boost::asio::buffer(player->reader.header_data(), player->reader.header_size()),
+        boost::asio::use_awaitable);
+      if (!player->reader.begin()) {
+        boost::system::error_code ignored;
+        player->socket.close(ignored);
+        co_return;
+      }
+      size_t length;
+      do {
+        size_t chunk_size;
+        char* chunk = player->reader.next_chunk(chunk_size);
+        length = co_await boost::asio::async_read(player->socket,
+          boost::asio::buffer(chunk, chunk_size), boost::asio::use_awaitable);
+      } while (!player->reader.consume(length));
+      valid = decode_command(player->reader.data(), player->reader.size(), command);
+      player->reader.reset();
+    } catch (const boost::system::system_error&) {
+      co_return; // gone, or timed out, before finishing its command
     }
-  }
-
-  void handle_read_header(std::shared_ptr<Player> player, boost::system::error_code ec, std::size_t /*length*/) {
-    if (!ec) {
-      player->expected_message_length = ntohl(player->expected_message_length);
-      player->reading_header = false;
-      start_read(player); // Proceed to read the body
-    } else {
-        handle_disconnect(player, ec);
+    timeout.cancel();
+    if (valid && command.code == CommandCode::Reconnect) {
+      resume_session(player, command.target);
+      co_return;
+    }
+    if (valid && command.code == CommandCode::Spectate) {
+      watch_match(player, command.target);
+      co_return;
     }
+    if (valid && command.code != CommandCode::Join) {
+      player->first_command = command;
+    }
+    seat_player(player);
   }
 
-  void handle_read_body(std::shared_ptr<Player> player, boost::system::error_code ec, std::size_t /*length*/) {
-    // Just interprets the command and starts reading again.
-    if (!ec) {
-      std::string json_str(
-        player->read_buffer.begin(),
-        player->read_buffer.begin() + player->expected_message_length
-      );
-      
-      try {
-          // Deserialize the Command from JSON
-        nlohmann::json j = nlohmann::json::parse(json_str);
-        Command command;
-        from_json(j, command);        
-        handle_command(player, command);
-      } catch (const nlohmann::json::parse_error& e) {
-        std::cerr << "JSON parse error " << player->id << ": " << e.what() << "\n";
-        send_message(player, "Invalid command format");
-      }
-      
-      // Reset for next message
-      player->reading_header = true;
-      start_read(player);
-    } else {
-        handle_disconnect(player, ec);
-    }
+  std::string new_session_token() {
+    // 128 bits straight from the OS entropy source: a token must not
+    // tell anything about the next ones.
+    std::random_device entropy;
+    std::ostringstream token;
+    token << std::hex << std::setfill('0');
+    for (int i = 0; i < 4; i++) token << std::setw(8) << entropy();
+    return token.str();
   }
 
-  void handle_disconnect(std::shared_ptr<Player> player, boost::system::error_code ec) {
-  // simple handling of disconnection of a player.
-    if (player->connected) {
-      std::cout << "Player " << player->id << " disconnected: " << ec.message() << "\n";
-      player->connected = false;
-      connected_players--;
-      // Notify other players about disconnection
-      broadcast_message("Player " + std::to_string(player->id) + " has left the game");
-      // Handle game state changes due to disconnection
-      handle_player_resignation(player);
+  void resume_session(std::shared_ptr<Player> player, const std::string& token) {
+    // Hands the connection to the match that owns the session.
+    auto session = sessions.find(token);
+    auto match = session == sessions.end() ? matches.end() : matches.find(session->second);
+    if (match == matches.end()) {
+      auto frame = make_shared_frame(MESSAGE_unknown_session);
+      boost::asio::async_write(player->socket, boost::asio::buffer(*frame),
+        [player, frame](boost::system::error_code, std::size_t) {
+          boost::system::error_code ignored;
+          player->socket.close(ignored);
+        });
+      return;
     }
-  }
-    
-  void handle_command(std::shared_ptr<Player> player, const Command &command) {
-      std::cout << "Received command from player " << player->id << ": " << command.toString()<< "\n";
-      if (command.code == CommandCode::Quit || command.code == CommandCode::Resign) {
-        handle_player_resignation(player);
-        return;
-      }
-      // Process the command for the player with priority
-      std::cout<<MESSAGE_processing_command;
-      std::string response = process_game_command(player, command);
-      send_message(player, response);
-      // Update game state and notify all players if needed
+    player->session_token = token;
+    match->second->rejoin(player);
   }
 
-  std::string download_card_info(std::string &card_name){
-    // Downloads JSON info.
-    ScryfallAPI api;
-    std::string card_info = api.getCardByName(card_name);
-    return card_info;
+  void watch_match(std::shared_ptr<Player> player, const std::string& target) {
+    // The connection becomes a spectator of a running match.
+    auto match = matches.end();
+    try {
+      match = matches.find(static_cast<unsigned>(std::stoul(target)));
+    } catch (const std::exception&) {}
+    if (match == matches.end()) {
+      auto frame = make_shared_frame(MESSAGE_unknown_match);
+      boost::asio::async_write(player->socket, boost::asio::buffer(*frame),
+        [player, frame](boost::system::error_code, std::size_t) {
+          boost::system::error_code ignored;
+          player->socket.close(ignored);
+        });
+      return;
+    }
+    match->second->spectate(std::make_shared<Spectator>(std::move(player->socket)));
   }
 
-  bool parse_deck(std::shared_ptr<Player> player, const Command& command){
+  void seat_player(std::shared_ptr<Player> player) {
     /*
-      This function parses a deck in the standard MTGO format.
-      Probably needs extra refinment and security checks.
-      AI kinds of writes very convoluted code, so I wrote this myself.
+      Seats the new connection at the lobby table. When the lobby
+      table is full it becomes a running match and the next
+      connection will open a new one.
+      Seats are counted here, on the server strand, so pairing
+      never needs to look inside a match.
     */
-    std::cout<<player->id<<" has uploaded a deck: \n";
-    std::cout<<command.target<<std::endl;
-    player->deck.clear();
-    // turn string into vector of cards and assign it to player.
-    std::cout<<"parse_deck -> starting deck_parsing..."<<std::endl;
-    std::stringstream is(command.target);
-    std::string line;
-    int copies;
-    bool sideboard = false;
-    std::string name;
-    while(true){
-      if(!std::getline(is,line)){
-        std::cout<<"Reached end of list.\n";
-        player->print_raw_deck();
-        return true;
-      }
-      std::stringstream is_line(line);
-      is_line>>copies;
-      is_line.ignore(1);
-      if(!std::getline(is_line,name)){
-        std::cout<<"Something went wrong during parsing.\n";
-        return false;
-      }
-      for(int i = 0; i < copies; i++){
-        // add card to either sideboard or main deck
-        if(sideboard)
-          player->sideboard.emplace_back(info.card_id++, name, "", "", 0);
-        else
-          player->deck.emplace_back(info.card_id++, name, "", "", 0);
-      }
-      if((int)is.peek() == 13){
-        sideboard = true;
-        is.ignore(2); // ignore carriage return and newline.
-      }
-    } 
-    return false;
-  }
-
-  std::string process_game_command(std::shared_ptr<Player> player, const Command &command) {
-    // This is where you'd implement your actual game logic
-    // The string is returned and sent to the client for now.
-    if(command.code == CommandCode::UploadDeck){
-      if(parse_deck(player,command)){
-        player->validated = true;
-        return MESSAGE_correct_deck_upload;
-      }
-      else return MESSAGE_error_upload;
+    if (!lobby || lobby_seats >= MATCH_PLAYERS) {
+      open_lobby();
     }
-    return MESSAGE_error_unknown_command;
-  }
-    
-  void handle_player_resignation(std::shared_ptr<Player> player) {
-    // Just disconnects every player.
-    std::string message = "Player " + std::to_string(player->id) + " has resigned. Game over.";
-    broadcast_message(message);
-    // Close all connections and stop the server
-    for (auto& p : players) {
-      if (p->connected && p != player) {
-        try {
-            p->socket.close();
-        } catch (...) {}
-        p->connected = false;
-      }
+    lobby_seats++;
+    if (!player->session_token.empty()) {
+      sessions.erase(player->session_token); // seated again after a rejection
+    }
+    player->session_token = new_session_token();
+    sessions[player->session_token] = lobby->get_id();
+    match_sessions[lobby->get_id()].push_back(player->session_token);
+    lobby->join(player);
+    if (lobby_seats >= MATCH_PLAYERS) {
+      LOG_INFO(Server, "Match ", lobby->get_id(), " is full. ", matches.size(), " matches running.");
     }
-    std::cout << message << "\n";
   }
 
-  void send_message(std::shared_ptr<Player> player, const std::string& message) {
-    // Sends an asyncronous message to target player.
-
-    if (!player->connected) return;
-    // create shared pointer to message to avoid deallocating it      
-    auto msg_copy = std::make_shared<std::string>(message);
-    // get the length of the message and use htonl to make
-    // it tranasferable through network.
-    uint32_t len = htonl(static_cast<uint32_t>(message.size()));
-    // creates a buffer to store the lenght 
-    auto len_buffer = std::make_shared<std::array<char, sizeof(uint32_t)>>();
-    // copy the length into the buffer.
-    std::memcpy(len_buffer->data(), &len, sizeof(uint32_t));
-    
-    // create a vector of buffers to send together. 
-    std::vector<boost::asio::const_buffer> buffers;
-    // put in the buffer the length buffer and the message buffer.
-    buffers.push_back(boost::asio::buffer(*len_buffer));
-    buffers.push_back(boost::asio::buffer(*msg_copy));
-    // send the buffers and the lambda is the callback,
-    // so just a function executed when the operation is finished. 
-    // Inside the callback you can use the captured parameters.
-    boost::asio::async_write(player->socket, buffers,
-      [this, player, msg_copy, len_buffer](boost::system::error_code ec, std::size_t length) {
-        if (ec) { // if error during sending...
-          handle_disconnect(player, ec);
-        }
-      });
+  void open_lobby() {
+    // Creates a new table that will receive the next connections.
+    // Match callbacks come from the match strand and are moved
+    // back on the server strand.
+    unsigned match_id = next_match_id++;
+    lobby = std::make_shared<Match>(io_context, match_id,
+      [this](unsigned finished_id) {
+        boost::asio::post(strand, std::bind(&GameServer::close_match, this, finished_id));
+      },
+      [this](std::shared_ptr<Player> player) {
+        boost::asio::post(strand, std::bind(&GameServer::seat_player, this, player));
+      },
+      *deck_validator, log_dir.empty() ? "" : log_dir + "/match_" + std::to_string(match_id) + ".bin");
+    lobby_seats = 0;
+    matches.emplace(match_id, lobby);
+    Metrics::instance().matches = static_cast<int64_t>(matches.size());
   }
 
-  void broadcast_message(const std::string& message) {
-    // Sends a string to all players.
-    for (auto& player : players) {
-      if (player->connected) {
-          send_message(player, message);
-      }
+  void close_match(unsigned match_id) {
+    // Called by a match when its game is over.
+    if (lobby && lobby->get_id() == match_id) {
+      lobby.reset(); // the lobby table was abandoned before it filled up
     }
-  }
-    
-  void send_player_info(std::shared_ptr<Player> player) {
-    // Sends private information to target player. 
-    nlohmann::json j;
-    j["player_id"] = player->info.player_id;
-    j["hand_cards"] = player->info.hand_cards;
-    send_message(player, j.dump());
-  }
-
-// void send_public_info(std::shared_ptr<Player> player) { 
-//   // Sends information about game state to target player.
-//   nlohmann::json j;
-//   j["turn"] = info.turn;
-//   j["priority"] = info.priority;
-//   j["life_points"] =  info.life_points;
-//   send_message(player, j.dump());
-// }
-
-  void send_available_commands(std::shared_ptr<Player> player) { 
-    // Sends available commands to target player. Needed for frontend.
-    std::vector<CommandCode> commands;
-    commands = {CommandCode::UploadDeck};
-    nlohmann::json j = serializeCommandCodeVector(commands);
-    send_message(player, j.dump());
+    matches.erase(match_id);
+    for (auto& token : match_sessions[match_id]) {
+      sessions.erase(token);
+    }
+    match_sessions.erase(match_id);
+    Metrics::instance().matches = static_cast<int64_t>(matches.size());
+    LOG_INFO(Server, "Match ", match_id, " closed. ", matches.size(), " matches running.");
   }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
+  /*
+    Usage: ./server_app [threads] [metrics_port] [logs_dir]
+    The io_context is run by a pool of threads, by default one
+    per available core. Metrics are served on 127.0.0.1:metrics_port.
+    Match event logs are written in logs_dir/<start time>/.
+  */
+  unsigned threads = std::thread::hardware_concurrency();
+  unsigned short metrics_port = METRICS_PORT;
+  std::string logs_dir = EVENT_LOG_DIR;
+  try {
+    if (argc > 1) {
+      threads = static_cast<unsigned>(std::stoul(argv[1]));
+    }
+    if (argc > 2) {
+      unsigned long port = std::stoul(argv[2]);
+      if (port > 65535) throw std::out_of_range("metrics_port");
+      metrics_port = static_cast<unsigned short>(port);
+    }
+  } catch (std::logic_error&) {
+    // std::invalid_argument or std::out_of_range from std::stoul
+    std::cerr << "Usage: ./server_app [threads] [metrics_port] [logs_dir]\n";
+    return 1;
+  }
+  if (argc > 3) {
+    logs_dir = argv[3];
+  }
+  if (threads == 0) threads = 1;
   try {
-    boost::asio::io_context io;
-    GameServer server(io);
+    boost::asio::io_context io(static_cast<int>(threads));
+    // Deck validation gets its own threads, half as many as the io ones.
+    GameServer server(io, logs_dir, std::max(1u, threads / 2));
     server.start();
+    MetricsServer metrics(io, metrics_port);
+    metrics.start();
+    LOG_INFO(Server, "Running io_context on ", threads, " threads.");
     // Run the io_context
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < threads; i++) {
+      pool.emplace_back([&io]() {
+        try {
+          io.run();
+        } catch (std::exception& e) {
+          LOG_ERROR(Server, "Server exception: ", e.what());
+        }
+      });
+    }
     io.run();
+    for (auto& t : pool) {
+      t.join();
+    }
   } catch (std::exception& e) {
       std::cerr << "Server exception: " << e.what() << "\n";
   }
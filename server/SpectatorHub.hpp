@@ -0,0 +1,141 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <boost/asio.hpp>
+#include "Framing.hpp"
+#include "SendQueue.hpp"
+#include "Metrics.hpp"
+
+#define SPECTATOR_QUEUE_LIMIT 8
+
+using boost::asio::ip::tcp;
+
+struct Spectator {
+  tcp::socket socket;
+  SendQueue send_queue;
+  bool connected;
+  std::array<char, 256> discard; // spectators are read-only
+  explicit Spectator(tcp::socket socket)
+    : socket(std::move(socket)), connected(true) {}
+};
+
+/*
+  Read-only observers of a match.
+  The match encodes every public update once and hands the shared
+  frame to the hub with a single post: the spectators live on the hub
+  strand, so their number and their sockets never add work to the
+  strand that runs the game.
+  A spectator that can't keep up keeps at most SPECTATOR_QUEUE_LIMIT
+  frames waiting, the oldest ones are skipped: every state frame
+  carries the whole public state, so the latest one is enough.
+*/
+class SpectatorHub : public std::enable_shared_from_this<SpectatorHub> {
+public:
+  SpectatorHub(boost::asio::io_context& io)
+    : strand(boost::asio::make_strand(io)), closing(false) {}
+
+  void add(std::shared_ptr<Spectator> spectator, SharedFrame greeting) {
+    boost::asio::dispatch(strand,
+      std::bind(&SpectatorHub::do_add, shared_from_this(), spectator, greeting));
+  }
+
+  void publish(SharedFrame frame, bool is_state = false) {
+    // Never blocks the caller: the fan-out happens on the hub strand.
+    // The last state frame is kept for the spectators joining later.
+    boost::asio::post(strand,
+      std::bind(&SpectatorHub::do_publish, shared_from_this(), frame, is_state));
+  }
+
+  void close() {
+    // The match is over: spectators are closed once their queue is empty.
+    boost::asio::post(strand, std::bind(&SpectatorHub::do_close, shared_from_this()));
+  }
+
+private:
+  using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+
+  void do_add(std::shared_ptr<Spectator> spectator, SharedFrame greeting) {
+    if (closing) {
+      boost::system::error_code ignored;
+      spectator->socket.close(ignored);
+      return;
+    }
+    spectators.push_back(spectator);
+    Metrics::instance().spectators++;
+    start_read(spectator);
+    spectator->send_queue.push(greeting);
+    if (latest) spectator->send_queue.push(latest);
+    flush(spectator);
+  }
+
+  void do_publish(SharedFrame frame, bool is_state) {
+    if (is_state) latest = frame;
+    for (auto& spectator : spectators) {
+      spectator->send_queue.push(frame);
+      Metrics::instance().spectator_frames_dropped += spectator->send_queue.trim(SPECTATOR_QUEUE_LIMIT);
+      flush(spectator);
+    }
+  }
+
+  void do_close() {
+    closing = true;
+    auto current = spectators; // shutdown() removes from the list
+    for (auto& spectator : current) {
+      if (spectator->send_queue.depth() == 0) shutdown(spectator);
+    }
+  }
+
+  void start_read(std::shared_ptr<Spectator> spectator) {
+    // Anything sent by a spectator is ignored, reading only
+    // tells us when the connection goes away.
+    spectator->socket.async_read_some(boost::asio::buffer(spectator->discard),
+      boost::asio::bind_executor(strand,
+        [self = shared_from_this(), spectator](boost::system::error_code ec, std::size_t /*length*/) {
+          if (ec) {
+            self->remove(spectator);
+            return;
+          }
+          self->start_read(spectator);
+        }));
+  }
+
+  void flush(std::shared_ptr<Spectator> spectator) {
+    if (!spectator->connected || !spectator->send_queue.start()) return;
+    boost::asio::async_write(spectator->socket, spectator->send_queue.buffers(),
+      boost::asio::bind_executor(strand,
+        [self = shared_from_this(), spectator](boost::system::error_code ec, std::size_t /*length*/) {
+          spectator->send_queue.done();
+          if (ec) {
+            self->remove(spectator);
+            return;
+          }
+          if (self->closing && spectator->send_queue.depth() == 0) {
+            self->shutdown(spectator);
+            return;
+          }
+          self->flush(spectator);
+        }));
+  }
+
+  void shutdown(std::shared_ptr<Spectator> spectator) {
+    boost::system::error_code ignored;
+    spectator->socket.close(ignored);
+    remove(spectator);
+  }
+
+  void remove(std::shared_ptr<Spectator> spectator) {
+    if (!spectator->connected) return;
+    spectator->connected = false;
+    spectator->send_queue.clear();
+    Metrics::instance().spectators--;
+    spectators.erase(std::remove(spectators.begin(), spectators.end(), spectator), spectators.end());
+  }
+
+  Strand strand;
+  std::vector<std::shared_ptr<Spectator>> spectators;
+  SharedFrame latest; // last public state, sent to new spectators
+  bool closing;
+};
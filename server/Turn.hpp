@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*
+  Steps of a turn and the per-player auto-pass settings.
+  A stop is a step where a player wants to get priority even if the
+  server could pass for them: one set for their own turns and one for
+  the turns of the opponent, as bits indexed by Step.
+*/
+
+enum class Step : uint8_t {
+  Untap = 0, // no priority
+  Upkeep,
+  Draw,
+  Main1,
+  BeginCombat,
+  DeclareAttackers,
+  DeclareBlockers,
+  CombatDamage,
+  EndCombat,
+  Main2,
+  End,
+  Cleanup, // no priority
+  Count
+};
+
+using StepMask = uint16_t;
+
+inline StepMask stepBit(Step step) { return static_cast<StepMask>(1u << static_cast<unsigned>(step)); }
+
+inline const char* stepToString(Step step) {
+  static const char* names[] = {"untap", "upkeep", "draw", "main1", "begin_combat", "declare_attackers",
+                                "declare_blockers", "combat_damage", "end_combat", "main2", "end", "cleanup"};
+  return step < Step::Count ? names[static_cast<size_t>(step)] : "unknown";
+}
+
+inline bool stepFromString(const std::string& name, Step& step) {
+  for (uint8_t i = 0; i < static_cast<uint8_t>(Step::Count); i++) {
+    if (name == stepToString(static_cast<Step>(i))) {
+      step = static_cast<Step>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool parseStops(const std::string& list, StepMask& mask) {
+  // Comma separated step names, e.g. "upkeep,main1,main2".
+  mask = 0;
+  size_t begin = 0;
+  while (begin < list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos) end = list.size();
+    Step step;
+    if (!stepFromString(list.substr(begin, end - begin), step)) return false;
+    mask |= stepBit(step);
+    begin = end + 1;
+  }
+  return true;
+}
+
+struct AutoPass {
+  StepMask own_stops = stepBit(Step::Main1) | stepBit(Step::Main2);
+  StepMask opponent_stops = 0;
+  unsigned yield_turn = 0; // "pass until end of turn" (F6) set during this turn number, 0 = none
+};
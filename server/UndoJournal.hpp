@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/*
+  Undo log of the game state, for cheap snapshots.
+  While a snapshot is open every change to the state (a field of
+  Game::info, an element of the ZoneStore arrays, an object created or
+  destroyed) appends the old value to the journal; rolling back replays
+  the journal backwards to the mark taken by the snapshot. Both cost
+  O(changes since the snapshot), whatever the size of the game, so the
+  rules can try a partial action (paying mana, choosing targets) and
+  undo it, and a search can fork many hypothetical states from one.
+  Snapshots nest. With no snapshot open nothing is recorded, but every
+  change still bumps version(): the state is the same as long as the
+  version is, which lets Match skip rebuilding the public state.
+  Entries point to the containers, not to their elements, so they
+  survive vector growth; the journaled objects must not be moved or
+  copied while a snapshot is open.
+*/
+
+class UndoJournal {
+public:
+  using Mark = size_t;
+
+  bool recording() const { return depth > 0; }
+  size_t size() const { return entries.size(); }
+  uint64_t version() const { return changes; }
+
+  Mark open() {
+    depth++;
+    return entries.size();
+  }
+
+  void rollback(Mark mark) {
+    // Undoes everything recorded since open() returned mark.
+    if (entries.size() > mark) changes++;
+    while (entries.size() > mark) {
+      const Entry& entry = entries.back();
+      entry.undo(entry.target, entry.index, entry.old);
+      entries.pop_back();
+    }
+    close();
+  }
+
+  void keep(Mark /*mark*/) {
+    // Keeps the changes: an enclosing snapshot can still undo them.
+    close();
+  }
+
+  template <typename T>
+  void set(T& value, std::type_identity_t<T> next) {
+    if (recording()) push(&restore_value<T>, &value, 0, pack(value));
+    value = next;
+    changes++;
+  }
+
+  template <typename T>
+  void set(std::vector<T>& array, uint32_t index, std::type_identity_t<T> next) {
+    if (recording()) push(&restore_element<T>, &array, index, pack(array[index]));
+    array[index] = next;
+    changes++;
+  }
+
+  template <typename T>
+  void push_back(std::vector<T>& array, std::type_identity_t<T> value) {
+    if (recording()) push(&restore_size<T>, &array, 0, array.size());
+    array.push_back(value);
+    changes++;
+  }
+
+  template <typename T>
+  T pop_back(std::vector<T>& array) {
+    T value = array.back();
+    if (recording()) push(&restore_push<T>, &array, 0, pack(value));
+    array.pop_back();
+    changes++;
+    return value;
+  }
+
+private:
+  struct Entry {
+    void (*undo)(void* target, uint32_t index, uint64_t old);
+    void* target;
+    uint32_t index;
+    uint64_t old;
+  };
+
+  template <typename T>
+  static uint64_t pack(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(uint64_t),
+                  "only small trivially copyable values are journaled");
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    return bits;
+  }
+
+  template <typename T>
+  static T unpack(uint64_t bits) {
+    T value;
+    std::memcpy(static_cast<void*>(&value), &bits, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  static void restore_value(void* target, uint32_t, uint64_t old) {
+    *static_cast<T*>(target) = unpack<T>(old);
+  }
+
+  template <typename T>
+  static void restore_element(void* target, uint32_t index, uint64_t old) {
+    (*static_cast<std::vector<T>*>(target))[index] = unpack<T>(old);
+  }
+
+  template <typename T>
+  static void restore_size(void* target, uint32_t, uint64_t old) {
+    static_cast<std::vector<T>*>(target)->resize(static_cast<size_t>(old));
+  }
+
+  template <typename T>
+  static void restore_push(void* target, uint32_t, uint64_t old) {
+    static_cast<std::vector<T>*>(target)->push_back(unpack<T>(old));
+  }
+
+  void push(void (*undo)(void*, uint32_t, uint64_t), void* target, uint32_t index, uint64_t old) {
+    entries.push_back(Entry{undo, target, index, old});
+  }
+
+  void close() {
+    if (depth > 0) depth--;
+    if (depth == 0) entries.clear();
+  }
+
+  std::vector<Entry> entries;
+  unsigned depth = 0;
+  uint64_t changes = 0;
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Card.hpp"
+#include "ObjectArena.hpp"
+#include "UndoJournal.hpp"
+
+/*
+  The game objects of a match and where they are, stored as parallel
+  arrays indexed by the arena slot of the object: the fields looked at
+  by the rules (kind, owner, controller, zone, tapped, definition,
+  counters) are each in a contiguous array, so scans like "untapped
+  creatures you control" are linear passes over a few bytes per object.
+  Destroyed objects leave a hole reused by the next one, see
+  ObjectArena.hpp; code outside the game refers to objects by handle
+  and resolves it with find().
+  The cards of each (player, zone) are also linked in an intrusive
+  doubly linked list, ordered bottom to top, kept in the prev / next
+  arrays: moving a card between zones is O(1) and the order of the
+  library or of the stack is kept without shifting vectors.
+  The arrays are public for reading; every change goes through the
+  methods, which record it in the journal while a snapshot is open
+  (see UndoJournal.hpp).
+*/
+
+#define ZONE_STORE_PLAYERS 2
+
+enum class Zone : uint8_t {
+  Library = 0,
+  Hand,
+  Battlefield,
+  Graveyard,
+  Exile,
+  Stack,
+  Command, // emblems
+  Sideboard, // outside the game
+  Count,
+  None = Count // destroyed object, or free arena slot
+};
+
+inline const char* zoneToString(Zone zone) {
+  static const char* names[] = {"library", "hand", "battlefield", "graveyard", "exile", "stack", "command",
+                                "sideboard", "none"};
+  return names[static_cast<size_t>(zone)];
+}
+
+enum class ObjectKind : uint8_t {
+  Card = 0,
+  Token,
+  Ability, // on the stack, source is the object it comes from
+  Emblem
+};
+
+class ZoneStore {
+public:
+  using Instance = uint32_t;
+  static constexpr Instance npos = ObjectArena::npos;
+
+  ZoneStore() {
+    for (auto& lists : zones) lists.fill(List());
+  }
+
+  size_t size() const { return definition.size(); } // slots, including the free ones
+  size_t live() const { return arena.live(); }
+  size_t room() const { return OBJECT_ARENA_CAPACITY - live(); }
+
+  void reserve(size_t objects) {
+    definition.reserve(objects);
+    kind.reserve(objects);
+    owner.reserve(objects);
+    controller.reserve(objects);
+    zone.reserve(objects);
+    tapped.reserve(objects);
+    counters.reserve(objects);
+    source.reserve(objects);
+    prev.reserve(objects);
+    next.reserve(objects);
+  }
+
+  Instance create(ObjectKind what, CardDefinitionId card, uint8_t player, Zone to,
+                  ObjectHandle from = ObjectHandle()) {
+    // New object on top of the zone of its owner, npos if the arena is full.
+    Instance instance = arena.allocate(journal);
+    if (instance == npos) return npos;
+    if (instance == size()) {
+      journal.push_back(definition, card);
+      journal.push_back(kind, what);
+      journal.push_back(owner, player);
+      journal.push_back(controller, player);
+      journal.push_back(zone, Zone::None);
+      journal.push_back(tapped, false);
+      journal.push_back(counters, 0);
+      journal.push_back(source, from);
+      journal.push_back(prev, npos);
+      journal.push_back(next, npos);
+    } else {
+      journal.set(definition, instance, card);
+      journal.set(kind, instance, what);
+      journal.set(owner, instance, player);
+      journal.set(controller, instance, player);
+      journal.set(tapped, instance, false);
+      journal.set(counters, instance, 0);
+      journal.set(source, instance, from);
+    }
+    link_top(instance, to);
+    return instance;
+  }
+
+  void destroy(Instance instance) {
+    unlink(instance);
+    arena.release(instance, journal);
+  }
+
+  ObjectHandle handle(Instance instance) const { return arena.handle(instance); }
+
+  Instance find(ObjectHandle handle) const {
+    // npos for handles of destroyed objects.
+    return arena.contains(handle) ? handle.index() : npos;
+  }
+
+  void move(Instance instance, Zone to) {
+    // On top of the destination zone of the controller.
+    unlink(instance);
+    link_top(instance, to);
+  }
+
+  void move_to_bottom(Instance instance, Zone to) {
+    unlink(instance);
+    if (to == Zone::None) return;
+    List& list = zones[controller[instance]][static_cast<size_t>(to)];
+    journal.set(zone, instance, to);
+    journal.set(prev, instance, npos);
+    journal.set(next, instance, list.bottom);
+    if (list.bottom != npos) journal.set(prev, list.bottom, instance);
+    else journal.set(list.top, instance);
+    journal.set(list.bottom, instance);
+    journal.set(list.count, list.count + 1);
+  }
+
+  void set_controller(Instance instance, uint8_t player) {
+    // Zone lists are per controller: relink on top of the new one.
+    Zone in = zone[instance];
+    unlink(instance);
+    journal.set(controller, instance, player);
+    link_top(instance, in);
+  }
+
+  void set_tapped(Instance instance, bool value) { journal.set(tapped, instance, value); }
+  void add_counters(Instance instance, int32_t amount) { journal.set(counters, instance, counters[instance] + amount); }
+
+  size_t count(uint8_t player, Zone in) const { return zones[player][static_cast<size_t>(in)].count; }
+  Instance top(uint8_t player, Zone in) const { return zones[player][static_cast<size_t>(in)].top; }
+  Instance bottom(uint8_t player, Zone in) const { return zones[player][static_cast<size_t>(in)].bottom; }
+
+  Instance next_in_zone(Instance instance) const { return next[instance]; } // towards the top
+
+  template <typename F>
+  void for_each(uint8_t player, Zone in, F f) const {
+    // Bottom to top, f may not move the card it's given.
+    for (Instance i = bottom(player, in); i != npos; i = next[i]) f(i);
+  }
+
+  Card card(Instance instance) const { return Card(handle(instance).value, definition[instance]); }
+
+  std::vector<Card> cards(uint8_t player, Zone in) const {
+    std::vector<Card> out;
+    out.reserve(count(player, in));
+    for_each(player, in, [&](Instance i) { out.push_back(card(i)); });
+    return out;
+  }
+
+  // Hot fields, one entry per arena slot.
+  std::vector<CardDefinitionId> definition;
+  std::vector<ObjectKind> kind;
+  std::vector<uint8_t> owner;
+  std::vector<uint8_t> controller;
+  std::vector<Zone> zone;
+  std::vector<uint8_t> tapped; // not vector<bool>: one byte per card, no bit twiddling
+  std::vector<int32_t> counters;
+  std::vector<ObjectHandle> source;
+
+  UndoJournal journal; // changes to the game state, see Game::snapshot
+
+private:
+  struct List {
+    Instance bottom = npos;
+    Instance top = npos;
+    uint32_t count = 0;
+  };
+
+  void link_top(Instance instance, Zone to) {
+    if (to == Zone::None) return;
+    List& list = zones[controller[instance]][static_cast<size_t>(to)];
+    journal.set(zone, instance, to);
+    journal.set(next, instance, npos);
+    journal.set(prev, instance, list.top);
+    if (list.top != npos) journal.set(next, list.top, instance);
+    else journal.set(list.bottom, instance);
+    journal.set(list.top, instance);
+    journal.set(list.count, list.count + 1);
+  }
+
+  void unlink(Instance instance) {
+    Zone from = zone[instance];
+    if (from == Zone::None) return;
+    List& list = zones[controller[instance]][static_cast<size_t>(from)];
+    Instance before = prev[instance], after = next[instance];
+    if (before != npos) journal.set(next, before, after);
+    else journal.set(list.bottom, after);
+    if (after != npos) journal.set(prev, after, before);
+    else journal.set(list.top, before);
+    journal.set(prev, instance, npos);
+    journal.set(next, instance, npos);
+    journal.set(zone, instance, Zone::None);
+    journal.set(list.count, list.count - 1);
+  }
+
+  ObjectArena arena;
+  std::vector<Instance> prev;
+  std::vector<Instance> next;
+  std::array<std::array<List, static_cast<size_t>(Zone::Count)>, ZONE_STORE_PLAYERS> zones;
+};
@@ -3,6 +3,8 @@
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 #include "Scryfall.hpp"
+#include "CardIndex.hpp"
+#include "CardNameMatcher.hpp"
 #include "Preview.hpp"
 
 #include <vector>
@@ -10,6 +12,7 @@
 #include <atomic>
 #include <mutex>
 #include <queue>
+#include <unordered_map>
 #include "RenderedCard.hpp"
 #include "Utils.hpp"
 
@@ -38,7 +41,7 @@ struct CardLoadTask {
   size_t task_id;
 };
 struct LoadedCard {
-    std::string title;
+    CardDefinitionId definition;
     int cmc;
     std::vector<unsigned char> image_data; // Raw image data
     int copies;
@@ -63,6 +66,10 @@ public:
       preview_width = area.w / 4;
       update_areas();
       preview = new Preview(renderer, font, preview_area);
+      // Built by ingest_app, without it every card goes through the API.
+      if (card_index.open()) {
+        LOG_INFO(Ui, "Card database: ", card_index.size(), " cards in ", CARD_INDEX_FILE);
+      }
   }
   
   ~DeckVisualizer() {
@@ -425,10 +432,13 @@ private:
     // Clear previous data
     cols.clear();
     allCards.clear();
-    // Group cards by name and count
-    std::map<std::string, int> cardCounts;
+    // Group cards by definition and count, in deck order
+    std::vector<std::pair<CardDefinitionId, int>> cardCounts;
+    std::unordered_map<CardDefinitionId, size_t> group_of;
     for (const auto& card : deck) {
-      cardCounts[card.title]++;
+      auto group = group_of.emplace(card.definition, cardCounts.size());
+      if (group.second) cardCounts.emplace_back(card.definition, 0);
+      cardCounts[group.first->second].second++;
     }
     // Create columns and tasks
     Column col;
@@ -448,15 +458,15 @@ private:
       
       // Create task for this card
       CardLoadTask task;
-      task.card_info.title = pair.first;
+      task.card_info.definition = pair.first;
       task.copies = pair.second;
       task.column_index = current_column;
       task.task_id = task_counter++;
       // Add placeholder cards to column
       for (int i = 0; i < pair.second; i++) {
         RenderedCard placeholder;
-        placeholder.game_info.title = pair.first;
-        placeholder.game_info.cmc = -1; // Mark as not loaded
+        placeholder.game_info.definition = pair.first;
+        placeholder.cmc = -1; // Mark as not loaded
         placeholder.texture = nullptr;
         placeholder.w = 0;
         placeholder.h = 0;
@@ -485,52 +495,94 @@ void load_cards_background() {
    * with all the cards that need to be loaded. It leverages
    * the Scryfall module to either download cards using the API
    * or just load them from disk if they are available in the data folder.
+   * The images are downloaded several at a time.
    * ML
   */
-  ScryfallAPI api; 
-  while (true) {
-    CardLoadTask task;
-    bool has_task = false;
+  // Cards missing from the local database are asked to the API all
+  // at once, and resolved before the downloads start: a request to the
+  // API from inside them would hold up every image in flight.
+  std::unordered_map<std::string, CardRecord> remote;
+  {
+    std::queue<CardLoadTask> tasks;
     {
       std::lock_guard<std::mutex> lock(task_mutex);
-      if (!pending_tasks.empty()) {
+      tasks = pending_tasks;
+    }
+    std::vector<std::string> unknown;
+    for (; !tasks.empty(); tasks.pop()) {
+      if (!local_record(tasks.front().card_info.title())) unknown.push_back(tasks.front().card_info.title());
+    }
+    if (!unknown.empty()) api.prefetchCardRecords(unknown);
+    for (const std::string& title : unknown) {
+      if (!remote.count(title)) remote.emplace(title, api.getCardRecord(title));
+    }
+  }
+  // Tasks whose image is being fetched, by task id.
+  std::unordered_map<size_t, LoadedCard> loading;
+  api.downloadImagesCached(
+    [&](ImageDownload& download) {
+      while (true) {
+        CardLoadTask task;
+        {
+          std::lock_guard<std::mutex> lock(task_mutex);
+          if (pending_tasks.empty()) return false;
           task = pending_tasks.front();
           pending_tasks.pop();
-          has_task = true;
+        }
+        try {
+          // Load card data, from the local database when it has the card,
+          // even misspelled
+          LoadedCard& loaded_card = loading[task.task_id];
+          loaded_card.definition = task.card_info.definition;
+          loaded_card.copies = task.copies;
+          loaded_card.column_index = task.column_index;
+          loaded_card.task_id = task.task_id;
+          const CardIndexRecord* record = local_record(task.card_info.title());
+          if (record) {
+            download.url = card_index.string(record->images[0]);
+            loaded_card.cmc = static_cast<int>(record->cmc);
+          } else {
+            const CardRecord& card = remote[task.card_info.title()];
+            download.url = card.image_url;
+            loaded_card.cmc = card.cmc;
+          }
+          download.id = task.task_id;
+          return true;
+        } catch (const std::exception& e) {
+          LOG_ERROR(Ui, "Error loading card ", task.card_info.title(), ": ", e.what());
+          loading.erase(task.task_id);
+          completed_tasks++;
+        }
       }
-    }
-    if (!has_task) {
-      loading_state = LoadingState::COMPLETED;
-      columns_initialized = true;
-      break;
-    }
-    try {
-      // Load card data
-      std::string card_info = api.getCardByName(task.card_info.title);
-      std::string url = api.getCardImageURL(card_info);
-      int cmc = api.getCardCmc(card_info);
-      // Download image data (not texture)
-      auto imageData = api.downloadImageCached(url);
-      // Create loaded card with image data
-      LoadedCard loaded_card;
-      loaded_card.title = task.card_info.title;
-      loaded_card.cmc = cmc;
-      loaded_card.image_data = imageData; // Store raw data
-      loaded_card.copies = task.copies;
-      loaded_card.column_index = task.column_index;
-      loaded_card.task_id = task.task_id;
+    },
+    [&](size_t task_id, std::vector<unsigned char>&& image_data) {
+      auto it = loading.find(task_id);
+      if (it == loading.end()) return;
+      it->second.image_data = std::move(image_data); // Store raw data, the texture is made by the main thread
       {
-          std::lock_guard<std::mutex> lock(completed_mutex);
-          completed_loads.push(loaded_card);
+        std::lock_guard<std::mutex> lock(completed_mutex);
+        completed_loads.push(std::move(it->second));
       }
+      loading.erase(it);
       completed_tasks++;
-    } catch (const std::exception& e) {
-        std::cerr << "Error loading card " << task.card_info.title << ": " << e.what() << std::endl;
-        completed_tasks++;
-    }
-  }
+    });
+  loading_state = LoadingState::COMPLETED;
+  columns_initialized = true;
 }
  
+const CardIndexRecord* local_record(const std::string& title) const {
+  const CardIndexRecord* record = card_index.find(title);
+  if (!record && card_index.size() > 0) {
+    // The matcher is only built for the first name not found as is.
+    std::call_once(name_matcher_built, [this]() {
+      for (uint32_t i = 0; i < card_index.size(); i++) name_matcher.add(card_index.string(card_index.record(i).name), i);
+    });
+    uint32_t match = name_matcher.match(title);
+    if (match != CardNameMatcher::npos) record = &card_index.record(match);
+  }
+  return record;
+}
+
 void process_completed_loads() {
   /*
    * This function retrieves cards that have been 
@@ -549,8 +601,8 @@ void process_completed_loads() {
       // Update cards with matching name
       int updated = 0;
       for (auto& card : cols[loaded.column_index].cards) {
-        if (card.game_info.title == loaded.title && updated < loaded.copies) {
-          card.game_info.cmc = loaded.cmc;
+        if (card.game_info.definition == loaded.definition && updated < loaded.copies) {
+          card.cmc = loaded.cmc;
           card.texture = texture;
           card.w = 20;  // Set appropriate dimensions
           card.h = 30;
@@ -602,6 +654,10 @@ void process_completed_loads() {
   std::atomic<size_t> total_tasks;
   std::atomic<size_t> completed_tasks;
   size_t task_counter;
+  CardIndex card_index; // read only once open, shared with the loading thread
+  ScryfallAPI api; // only used by the loading thread, its records outlive a deck
+  mutable std::once_flag name_matcher_built;
+  mutable CardNameMatcher name_matcher; // over the names of card_index, built on first use
 
   float card_scale;        // Card size scaling factor
 };
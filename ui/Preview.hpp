@@ -55,9 +55,9 @@ public:
         
         // Render text
         SDL_Color textColor = {255, 255, 255, 255};
-        render_text(card->game_info.title, textColor, cardRect.y + cardRect.h + 10);
+        render_text(card->game_info.title(), textColor, cardRect.y + cardRect.h + 10);
         
-        std::string cmcText = "CMC: " + std::to_string(card->game_info.cmc);
+        std::string cmcText = "CMC: " + std::to_string(card->cmc);
         render_text(cmcText, textColor, cardRect.y + cardRect.h + 35);
       }
       SDL_RenderSetViewport(renderer, &original_viewport);
@@ -4,6 +4,7 @@
 
 struct RenderedCard{
   Card game_info; // Changed from pointer to actual object
+  int cmc; // from Scryfall, -1 until loaded
   SDL_Texture* texture;
   int w;
   int h;
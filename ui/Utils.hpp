@@ -1,7 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
-#include <iostream>
+#include "Log.hpp"
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
@@ -10,13 +10,13 @@
 SDL_Texture* loadTextureFromMemory(SDL_Renderer* renderer, const std::vector<unsigned char>& imageData) {
   SDL_RWops* rw = SDL_RWFromConstMem(imageData.data(), imageData.size());
   if (!rw) {
-      std::cerr << "SDL_RWFromConstMem failed: " << SDL_GetError() << "\n";
+      LOG_ERROR(Ui, "SDL_RWFromConstMem failed: ", SDL_GetError());
       return nullptr;
   }
   
   SDL_Surface* surface = IMG_Load_RW(rw, 1);
   if (!surface) {
-      std::cerr << "IMG_Load_RW failed: " << IMG_GetError() << "\n";
+      LOG_ERROR(Ui, "IMG_Load_RW failed: ", IMG_GetError());
       return nullptr;
   }
   
@@ -25,7 +25,7 @@ SDL_Texture* loadTextureFromMemory(SDL_Renderer* renderer, const std::vector<uns
   SDL_FreeSurface(surface);
   
   if (!optimizedSurface) {
-      std::cerr << "Surface optimization failed: " << SDL_GetError() << "\n";
+      LOG_ERROR(Ui, "Surface optimization failed: ", SDL_GetError());
       return nullptr;
   }
   
@@ -53,7 +53,7 @@ void render_text(SDL_Renderer* renderer, TTF_Font* font, const std::string& text
 SDL_Texture* loadTexture(const std::string& path, SDL_Renderer* renderer) {
     SDL_Surface* surface = IMG_Load(path.c_str());
     if (!surface) {
-        std::cerr << "Unable to load image " << path << "! SDL_image Error: " << IMG_GetError() << std::endl;
+        LOG_ERROR(Ui, "Unable to load image ", path, "! SDL_image Error: ", IMG_GetError());
         return nullptr;
     }
     
@@ -61,7 +61,7 @@ SDL_Texture* loadTexture(const std::string& path, SDL_Renderer* renderer) {
     SDL_FreeSurface(surface);
     
     if (!texture) {
-        std::cerr << "Unable to create texture from " << path << "! SDL Error: " << SDL_GetError() << std::endl;
+        LOG_ERROR(Ui, "Unable to create texture from ", path, "! SDL Error: ", SDL_GetError());
         return nullptr;
     }
     
@@ -51,9 +51,9 @@ public:
     if (font) {
         SDL_Color textColor = {255, 255, 255, 255};
         // Render card name (pass viewport-relative Y coordinate)
-        renderTextCentered(card->game_info.title, textColor, cardRect.y + cardRect.h + 10);
+        renderTextCentered(card->game_info.title(), textColor, cardRect.y + cardRect.h + 10);
         // Render CMC
-        std::string cmcText = "CMC: " + std::to_string(card->game_info.cmc);
+        std::string cmcText = "CMC: " + std::to_string(card->cmc);
         renderTextCentered(cmcText, textColor, cardRect.y + cardRect.h + 35);
     }
     